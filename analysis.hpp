@@ -1,43 +1,75 @@
 #ifndef JJDE_ANALYSIS_HPP
 #define JJDE_ANALYSIS_HPP
 
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
 #include <map>
 #include <memory>
+#include <ostream>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include "disassembler.hpp"
 #include "instructions.hpp"
+#include "stats.hpp"
 
 namespace jjde {
 
+// Absolute targets of a TABLESWITCH or LOOKUPSWITCH instruction, the default target first. The
+// disassembler drops the padding, so the operands start with the default offset; all offsets are
+// relative to the switch instruction.
+std::vector<std::size_t> switch_targets(Instruction const& instruction) {
+    auto word = [&](std::size_t position) {
+        if (position + 4 > instruction.arguments.size()) throw std::logic_error("Invalid bytecode (truncated switch)");
+        return parse<int32_t>(convert<4>(instruction.arguments, position));
+    };
+    auto target = [&](std::size_t position) {
+        return (std::size_t) ((int64_t) instruction.location + word(position));
+    };
+    std::vector<std::size_t> targets{target(0)};
+    if (instruction.operation == Instruction::TABLESWITCH) {
+        // default, low, high, (high - low + 1) offsets
+        int64_t count = (int64_t) word(8) - word(4) + 1;
+        for (int64_t index = 0; index < count; ++index) targets.push_back(target(12 + 4 * index));
+    } else if (instruction.operation == Instruction::LOOKUPSWITCH) {
+        // default, pair count, (match, offset) pairs
+        int32_t count = word(4);
+        for (int32_t index = 0; index < count; ++index) targets.push_back(target(12 + 8 * index));
+    }
+    return targets;
+}
+
 struct CodeFlowItem {
-    std::vector<Instruction> instructions;
+    std::vector<Instruction const*> instructions; // Owned by the disassembly the code flow was built from
     std::vector<std::size_t> parents;
     std::vector<std::size_t> children;
     bool deleted = false;
 
     CodeFlowItem() : deleted(true) {}
-    CodeFlowItem(Instruction && single) {
-        instructions.emplace_back(std::move(single));
+    CodeFlowItem(Instruction const* single) {
+        instructions.push_back(single);
     }
 };
 
 struct CodeFlow {
     std::vector<std::shared_ptr<CodeFlowItem>> items;
     std::map<std::size_t, std::size_t> address_map;
-    std::vector<ExceptionHandler> exception_handlers;
+    std::vector<ExceptionHandler> const& exception_handlers;
 
-    CodeFlow(jjde::Bytecode && bytecode) : exception_handlers(std::move(bytecode.exception_handlers)) {
+    // The blocks refer to the instructions of the bytecode, which must outlive the code flow
+    explicit CodeFlow(jjde::Bytecode const& bytecode) : exception_handlers(bytecode.exception_handlers) {
+        JJDE_STATS_TIME(CODE_FLOW);
         for (std::size_t index = 0; index < bytecode.instructions.size(); ++index) {
             address_map.emplace(bytecode.instructions[index].location, index);
-            items.emplace_back(std::move(std::make_shared<CodeFlowItem>(std::move(bytecode.instructions[index]))));
+            items.emplace_back(std::make_shared<CodeFlowItem>(&bytecode.instructions[index]));
         }
 
         // Link items together
         for (std::size_t index = 0; index < items.size(); ++index) {
-            // Avoid copying instructions. Always just take the first element, since at this point, all items only contain one instruction
-            Instruction* ptr = items[index]->instructions.data();
+            // Always just take the first element, since at this point, all items only contain one instruction
+            Instruction const* ptr = items[index]->instructions.front();
 
             bool allow_jump_to_next;
             std::vector<std::size_t> additional_targets;
@@ -73,10 +105,14 @@ struct CodeFlow {
                 // Where on earth do we jump here?
                 throw std::runtime_error("Cannot analyze code flow with RET instructions");
             case Instruction::TABLESWITCH:
-                throw std::logic_error("TODO");
-                break;
             case Instruction::LOOKUPSWITCH:
-                throw std::logic_error("TODO");
+                // Only the listed targets (cases that share a target lead to the same block only once)
+                allow_jump_to_next = false;
+                for (std::size_t target : switch_targets(*ptr)) {
+                    if (std::find(additional_targets.begin(), additional_targets.end(), target) == additional_targets.end()) {
+                        additional_targets.push_back(target);
+                    }
+                }
                 break;
             case Instruction::IRETURN:
             case Instruction::LRETURN:
@@ -144,26 +180,121 @@ struct CodeFlow {
         }
 
         // Delete removed elements? Or is the required complexity (for each (deleted) item check all children/parents of each item) too much?
+
+        JJDE_STATS_COUNT(BLOCKS_BUILT, std::count_if(items.begin(), items.end(), [](std::shared_ptr<CodeFlowItem> const& item) { return !item->deleted; }));
     }
+
+    CodeFlow(jjde::Bytecode && bytecode) = delete;
 };
 
-void _visualize_code_flow(jjde::Bytecode copied) {
-    CodeFlow cf(std::move(copied));
-    for (std::size_t index = 0; index < cf.items.size(); ++index) {
-        if (cf.items[index]->deleted) continue;
-        std::cout << index;
-        std::cout << "\t\t\t\t\t<-- ";
-        for (std::size_t parent : cf.items[index]->parents) {
-            std::cout << parent << " ";
+/* Edges between the blocks of a code flow
+ *
+ * FLOW edges are the children of each block; those that lead to a block that does not start after the
+ * source block are BACK edges (loops). In addition, every block that contains an instruction covered by
+ * an exception handler gets an EXCEPTION edge to the block of the handler.
+ */
+
+struct CodeFlowEdge {
+    enum Kind : uint8_t { FLOW, BACK, EXCEPTION };
+
+    std::size_t from;
+    std::size_t to;
+    Kind kind;
+};
+
+std::vector<CodeFlowEdge> code_flow_edges(CodeFlow const& flow) {
+    std::vector<CodeFlowEdge> edges;
+    std::vector<std::pair<std::size_t, std::size_t>> locations; // Instruction location -> block, sorted by location
+    for (std::size_t index = 0; index < flow.items.size(); ++index) {
+        CodeFlowItem const& item = *flow.items[index];
+        if (item.deleted || item.instructions.empty()) continue;
+        for (Instruction const* instruction : item.instructions) {
+            locations.emplace_back(instruction->location, index);
+        }
+        for (std::size_t child : item.children) {
+            CodeFlowItem const& target = *flow.items[child];
+            bool back = !target.instructions.empty() && target.instructions.front()->location <= item.instructions.front()->location;
+            edges.push_back(CodeFlowEdge{index, child, back ? CodeFlowEdge::BACK : CodeFlowEdge::FLOW});
+        }
+    }
+    if (flow.exception_handlers.empty()) return edges;
+
+    // Merged blocks are not necessarily contiguous (unconditional jumps are followed), so the covered
+    // blocks are found through their instructions. Each handler only visits the instructions it covers.
+    std::sort(locations.begin(), locations.end());
+    std::vector<std::size_t> seen(flow.items.size(), (std::size_t) -1);
+    for (std::size_t handler = 0; handler < flow.exception_handlers.size(); ++handler) {
+        ExceptionHandler const& range = flow.exception_handlers[handler];
+        auto target = std::lower_bound(locations.begin(), locations.end(), std::make_pair<std::size_t, std::size_t>(range.handler, 0));
+        if (target == locations.end() || target->first != range.handler) continue;
+        for (auto it = std::lower_bound(locations.begin(), locations.end(), std::make_pair<std::size_t, std::size_t>(range.start, 0)); it != locations.end() && it->first < range.end; ++it) {
+            if (seen[it->second] == handler) continue;
+            seen[it->second] = handler;
+            edges.push_back(CodeFlowEdge{it->second, target->second, CodeFlowEdge::EXCEPTION});
         }
-        for (Instruction inst : cf.items[index]->instructions) {
-            std::cout << std::endl << "\t "  << std::uppercase << Instruction::name[inst.operation] << " " << hexencode(inst.arguments);
+    }
+    return edges;
+}
+
+/* Writing code flows
+ *
+ * All writers stream straight to the output, so the cost is linear in the size of the graph.
+ */
+
+// Blocks with their parents, instructions and children (the annotated text output)
+void write_code_flow(std::ostream & output, CodeFlow const& flow) {
+    for (std::size_t index = 0; index < flow.items.size(); ++index) {
+        CodeFlowItem const& item = *flow.items[index];
+        if (item.deleted) continue;
+        output << index;
+        output << "\t\t\t\t\t<-- ";
+        for (std::size_t parent : item.parents) {
+            output << parent << " ";
+        }
+        for (Instruction const* inst : item.instructions) {
+            output << "\n\t "  << std::uppercase << Instruction::name[inst->operation] << " ";
+            write_hex(output, inst->arguments.data(), inst->arguments.size());
         }
-        std::cout << "\t\t--> ";
-        for (std::size_t child : cf.items[index]->children) {
-            std::cout << child << " ";
+        output << "\t\t--> ";
+        for (std::size_t child : item.children) {
+            output << child << " ";
         }
-        std::cout << std::endl;
+        output << "\n";
+    }
+}
+
+// Graphviz digraph; blocks are labelled with the locations of their first and last instruction
+void write_dot(std::ostream & output, CodeFlow const& flow, std::string const& name) {
+    output << "digraph \"";
+    for (char c : name) {
+        if (c == '"' || c == '\\') output << '\\';
+        output << c;
+    }
+    output << "\" {\n    node [shape=box, fontname=monospace];\n";
+    output << std::hex << std::uppercase << std::setfill('0');
+    for (std::size_t index = 0; index < flow.items.size(); ++index) {
+        CodeFlowItem const& item = *flow.items[index];
+        if (item.deleted || item.instructions.empty()) continue;
+        output << "    b" << std::dec << index << " [label=\"" << index << ": " << std::hex
+               << std::setw(4) << item.instructions.front()->location << "-"
+               << std::setw(4) << item.instructions.back()->location
+               << std::dec << " (" << item.instructions.size() << ")\"];\n";
+    }
+    output << std::dec << std::setfill(' ');
+    for (CodeFlowEdge const& edge : code_flow_edges(flow)) {
+        output << "    b" << edge.from << " -> b" << edge.to;
+        if (edge.kind == CodeFlowEdge::BACK) output << " [color=blue, style=bold]";
+        else if (edge.kind == CodeFlowEdge::EXCEPTION) output << " [color=red, style=dashed]";
+        output << ";\n";
+    }
+    output << "}\n";
+}
+
+// One line per edge: source block, target block and kind (f: flow, b: back, e: exception)
+void write_edge_list(std::ostream & output, CodeFlow const& flow) {
+    static char const kinds[] = {'f', 'b', 'e'};
+    for (CodeFlowEdge const& edge : code_flow_edges(flow)) {
+        output << edge.from << ' ' << edge.to << ' ' << kinds[edge.kind] << '\n';
     }
 }
 
@@ -3,16 +3,20 @@
 
 #include "bytes.hpp"
 #include "class.hpp"
+#include "context.hpp"
+#include "debug.hpp"
 #include "disassembler.hpp"
-#include "simulation.hpp"
+#include "index.hpp"
+#include "stats.hpp"
 #include "types.hpp"
 
 namespace jjde {
 
+// Summary of a method's code (stack size, locals, exception handlers and attributes)
 struct Code {
-    Class class_;
-    Bytecode bytecode;
+    MethodContext context;
     std::string to_string() const {
+        Bytecode const& bytecode = context.bytecode;
         std::stringstream stream;
         stream << std::uppercase;
         stream << "        max. stack size: " << bytecode.max_stack_size << std::endl;
@@ -24,7 +28,7 @@ struct Code {
 				stream << "          (Any exception / finally)" << std::endl;
 			} else {
 				// Specified exception (class descriptor in constant pool)
-				stream << "          " << class_.constants[handler.exception].to_string(class_.constants) << std::endl;
+				stream << "          " << context.constant(handler.exception) << std::endl;
 			}
 			stream << "            " << std::hex << std::setfill('0')
 			                         << std::setw(4) << handler.start
@@ -34,21 +38,52 @@ struct Code {
                                      << std::setw(4) << handler.handler
                                      << std::endl;
         }
+        stream << "        line numbers:" << std::endl;
+        DebugInfo debug(bytecode.attributes, context.class_.attribute_kinds);
+        for (LineNumber const& entry : debug.lines()) {
+            stream << "          " << std::hex << std::setfill('0') << std::setw(4) << entry.start << std::dec << ": " << entry.line << std::endl;
+        }
         stream << "        attributes:" << std::endl;
         for (jjde::Attribute const& attribute : bytecode.attributes) {
-            stream << "          " << class_.constants[attribute.name_index].value.string << std::endl;
-            stream << "            " << hexencode(attribute.data) << std::endl;
+            stream << "          " << context.class_.constants[attribute.name_index].value.string << std::endl;
+            stream << "            ";
+            write_hex(stream, attribute.data.data(), attribute.data.size());
+            stream << std::endl;
         }
         return stream.str();
     }
 };
 
-Code annotate(Class const& class_, Bytecode const& bytecode, bool static_) {
-    Simulation simulation(class_, bytecode, static_);
+// Flags and declaring class of the target of a field or method reference, if the symbol index knows it
+std::string describe_reference(Class const& class_, uint16_t index, SymbolIndex const& symbols) {
+    Constant const& reference = class_.constants.at(index);
+    if (reference.type != Constant::FIELD_REFERENCE && reference.type != Constant::METHOD_REFERENCE && reference.type != Constant::INTERFACE_METHOD_REFERENCE) {
+        return "";
+    }
+    Constant const& owner = class_.constants.at(reference.value.pair_reference.first);
+    Constant const& name_type = class_.constants.at(reference.value.pair_reference.second);
+    std::string owner_name = decode_class_name(class_.constants.at(owner.value.reference).value.string);
+    std::string const& name = class_.constants.at(name_type.value.pair_reference.first).value.string;
+    std::string const& descriptor = class_.constants.at(name_type.value.pair_reference.second).value.string;
 
-    std::cout << std::setfill('0');
-    for (Instruction instruction : bytecode.instructions) {
-        std::cout << std::hex << "        " << std::setw(4) << std::uppercase << instruction.location << "\t" << Instruction::name[instruction.operation] << " " << hexencode(instruction.arguments);
+    std::optional<IndexedMember> target = symbols.resolve_member(owner_name, name, descriptor);
+    if (!target) return "";
+    std::string description = " [" + Flags(target->flags, target->is_method ? Flags::METHOD : Flags::FIELD).to_string();
+    if (target->owner != owner_name) {
+        description += (description.size() > 2 ? ", " : "") + std::string("declared in ") + std::string(target->owner);
+    }
+    return description + "]";
+}
+
+Code annotate(MethodContext const& context, std::ostream & output = std::cout, SymbolIndex const* symbols = nullptr) {
+    JJDE_STATS_TIME(ANNOTATION);
+    Class const& class_ = context.class_;
+    Bytecode const& bytecode = context.bytecode;
+
+    output << std::setfill('0');
+    for (Instruction const& instruction : bytecode.instructions) {
+        output << std::hex << "        " << std::setw(4) << std::uppercase << instruction.location << "\t" << Instruction::name[instruction.operation] << " ";
+        write_hex(output, instruction.arguments.data(), instruction.arguments.size());
         switch (instruction.operation) {
         // Show absolute jump information for IF... and GOTO... instructions
         case Instruction::GOTO:
@@ -69,57 +104,72 @@ Code annotate(Class const& class_, Bytecode const& bytecode, bool static_) {
         case Instruction::IF_ICMPLE:
         case Instruction::IF_ICMPLT:
         case Instruction::IF_ICMPNE:
-            std::cout << " (" << std::setw(4) << (instruction.location + parse<int16_t>(convert<2>(instruction.arguments))) << ")";
+            output << " (" << std::setw(4) << (instruction.location + parse<int16_t>(convert<2>(instruction.arguments))) << ")";
             break;
         // Show constant table information for instructions where it is required
         case Instruction::LDC:
             // One-byte index, constant value
-            std::cout << " (" << class_.constants[parse<uint8_t>(convert<1>(instruction.arguments))].to_string(class_.constants) << ")";
+            output << " (" << context.constant(parse<uint8_t>(convert<1>(instruction.arguments))) << ")";
             break;
         case Instruction::LDC_W:
         case Instruction::LDC2_W:
             // Two-byte index, constant value
-            std::cout << " (" << class_.constants[parse<uint16_t>(convert<2>(instruction.arguments))].to_string(class_.constants) << ")";
+            output << " (" << context.constant(parse<uint16_t>(convert<2>(instruction.arguments))) << ")";
             break;
         case Instruction::GETFIELD:
         case Instruction::GETSTATIC:
         case Instruction::PUTFIELD:
         case Instruction::PUTSTATIC:
             // Two-byte index, field reference
-            std::cout << " (" << class_.constants[parse<uint16_t>(convert<2>(instruction.arguments))].to_string(class_.constants) << ")";
+            output << " (" << context.constant(parse<uint16_t>(convert<2>(instruction.arguments))) << ")";
             break;
         case Instruction::ANEWARRAY:
         case Instruction::CHECKCAST:
         case Instruction::INSTANCEOF:
         case Instruction::NEW:
             // Two-byte index, class reference
-            std::cout << " (" << class_.constants[parse<uint16_t>(convert<2>(instruction.arguments))].to_string(class_.constants) << ")";
+            output << " (" << context.constant(parse<uint16_t>(convert<2>(instruction.arguments))) << ")";
             break;
         case Instruction::INVOKESPECIAL:
         case Instruction::INVOKESTATIC:
         case Instruction::INVOKEVIRTUAL:
             // Two-byte index, method reference
-            std::cout << " (" << class_.constants[parse<uint16_t>(convert<2>(instruction.arguments))].to_string(class_.constants) << ")";
+            output << " (" << context.constant(parse<uint16_t>(convert<2>(instruction.arguments))) << ")";
             break;
         case Instruction::MULTIANEWARRAY:
             // Index is two out of three argument bytes, class reference
-            std::cout << " (" << class_.constants[parse<uint16_t>(convert<2>(instruction.arguments))].to_string(class_.constants) << ")";
+            output << " (" << context.constant(parse<uint16_t>(convert<2>(instruction.arguments))) << ")";
             break;
         case Instruction::INVOKEDYMANIC:
             // Index is two out of four argument bytes, method reference
-            std::cout << " (" << class_.constants[parse<uint16_t>(convert<2>(instruction.arguments))].to_string(class_.constants) << ")";
+            output << " (" << context.constant(parse<uint16_t>(convert<2>(instruction.arguments))) << ")";
             break;
         case Instruction::INVOKEINTERFACE:
             // Index is two out of four argument bytes, method reference (third is another argument, therefore separate branches)
-            std::cout << " (" << class_.constants[parse<uint16_t>(convert<2>(instruction.arguments))].to_string(class_.constants) << ")";
+            output << " (" << context.constant(parse<uint16_t>(convert<2>(instruction.arguments))) << ")";
             break;
         default:
             break;
         }
-        std::cout << std::dec << std::endl;
-        //simulation.process(instruction);
+        if (symbols) {
+            switch (instruction.operation) {
+            case Instruction::GETFIELD:
+            case Instruction::GETSTATIC:
+            case Instruction::PUTFIELD:
+            case Instruction::PUTSTATIC:
+            case Instruction::INVOKESPECIAL:
+            case Instruction::INVOKESTATIC:
+            case Instruction::INVOKEVIRTUAL:
+            case Instruction::INVOKEINTERFACE:
+                output << describe_reference(class_, parse<uint16_t>(convert<2>(instruction.arguments)), *symbols);
+                break;
+            default:
+                break;
+            }
+        }
+        output << std::dec << std::endl;
     }
-    return Code { class_, bytecode };
+    return Code { context };
 }
 
 }
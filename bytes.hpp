@@ -5,53 +5,86 @@
 #include <array>
 #include <cmath>
 #include <fstream>
+#include <istream>
 #include <limits>
+#include <memory_resource>
+#include <sstream>
+#include <streambuf>
 #include <type_traits>
 #include <vector>
 
+#include "format.hpp"
+
 namespace jjde {
 
 /* Formatting byte data */
 
+// See format.hpp for writing hex dumps without building a string first
+
 std::string hexencode(std::string const& data) {
-    std::stringstream output;
-    output << std::hex << std::uppercase;
-    for (char c : data) {
-        int value = c;
-        if (value < 0) value += 256;
-        output << (value <= 15 ? "0" : "") << value << " ";
-    }
-    return output.str();
+    std::string output;
+    append_hex(output, reinterpret_cast<unsigned char const*>(data.data()), data.size());
+    return output;
 }
 
-std::string hexencode(std::vector<unsigned char> const& data) {
-    std::stringstream output;
-    output << std::hex << std::uppercase;
-    for (unsigned char uc : data) {
-        output << (uc <= 15 ? "0" : "") << (int) uc << " ";
-    }
-    return output.str();
+template <typename Allocator>
+std::string hexencode(std::vector<unsigned char, Allocator> const& data) {
+    std::string output;
+    append_hex(output, data.data(), data.size());
+    return output;
 }
 
+/* Streams over data in memory (without copying it) */
+
+class MemoryBuffer : public std::streambuf {
+public:
+    MemoryBuffer(unsigned char const* data, std::size_t size) {
+        char * begin = reinterpret_cast<char *>(const_cast<unsigned char *>(data));
+        setg(begin, begin, begin + size);
+    }
+
+protected:
+    pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode which) override {
+        if (!(which & std::ios_base::in)) return pos_type(off_type(-1));
+        char * base = (direction == std::ios_base::beg) ? eback() : (direction == std::ios_base::cur) ? gptr() : egptr();
+        if (base + offset < eback() || base + offset > egptr()) return pos_type(off_type(-1));
+        setg(eback(), base + offset, egptr());
+        return pos_type(gptr() - eback());
+    }
+
+    pos_type seekpos(pos_type position, std::ios_base::openmode which) override {
+        return seekoff(off_type(position), std::ios_base::beg, which);
+    }
+};
+
 /* Read bytes from the stream */
 
 template <std::size_t N>
-std::array<unsigned char, N> extract(std::ifstream & stream) {
+std::array<unsigned char, N> extract(std::istream & stream) {
     std::array<unsigned char, N> data;
-    for (std::size_t i = 0; i < N; ++i) {
-        data[i] = (unsigned char) stream.get();
-    }
+    stream.read(reinterpret_cast<char *>(data.data()), N);
     return data;
 }
 
-std::vector<unsigned char> extract(std::ifstream & stream, std::size_t N) {
+std::vector<unsigned char> extract(std::istream & stream, std::size_t N) {
     std::vector<unsigned char> data(N);
-    for (std::size_t i = 0; i < N; ++i) {
-        data[i] = (unsigned char) stream.get();
-    }
+    stream.read(reinterpret_cast<char *>(data.data()), (std::streamsize) N);
     return data;
 }
 
+// Allocated from the given memory resource (see Class::arena)
+std::pmr::vector<unsigned char> extract(std::istream & stream, std::size_t N, std::pmr::memory_resource * resource) {
+    std::pmr::vector<unsigned char> data(N, resource);
+    stream.read(reinterpret_cast<char *>(data.data()), (std::streamsize) N);
+    return data;
+}
+
+/* Skip bytes (without reading them, if the stream supports seeking) */
+
+void skip(std::istream & stream, std::size_t N) {
+    stream.seekg((std::streamoff) N, std::ios::cur);
+}
+
 /* Parse the bytes into a value */
 
 /* Parse unsigned integers */
@@ -123,8 +156,8 @@ typename std::enable_if<std::is_floating_point<T>::value && N == 8, T>::type par
 }
 
 /* Convert from variable-length vectors */
-template <std::size_t N>
-std::array<unsigned char, N> convert(std::vector<unsigned char> const& raw, std::size_t start=0) {
+template <std::size_t N, typename Allocator>
+std::array<unsigned char, N> convert(std::vector<unsigned char, Allocator> const& raw, std::size_t start=0) {
     std::array<unsigned char, N> array;
     for (std::size_t index = 0; index < N; ++index) {
         array[index] = raw[start + index];
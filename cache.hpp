@@ -0,0 +1,159 @@
+#ifndef JJDE_CACHE_HPP
+#define JJDE_CACHE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "hash.hpp"
+#include "version.hpp"
+
+namespace jjde {
+
+/* On-disk cache of rendered classes
+ *
+ * Entries are keyed by a hash of the class file's bytes, the jjde version and the options that affect
+ * the output, and are stored as <directory>/<2 hex digits>/<14 hex digits>. Several processes can share
+ * a cache directory:
+ *  - Writers write to a temporary file and rename it into place, so readers never see partial entries.
+ *  - Readers do not lock. The entry header repeats the full key and payload size, and anything that
+ *    does not match is treated as a miss.
+ *  - A hit updates the entry's modification time, which is the LRU order used for eviction. When the
+ *    cache grows beyond its size limit, the least recently used entries are removed until it is at
+ *    90% of the limit. Removing an entry another process is reading is harmless on POSIX systems.
+ */
+
+class ResultCache {
+public:
+    ResultCache(std::string const& directory_, uint64_t max_size_)
+        : directory(directory_)
+        , max_size(max_size_) {
+        std::filesystem::create_directories(directory);
+        current_size = scan().second;
+    }
+
+    static uint64_t key(std::vector<unsigned char> const& class_file, std::string const& options) {
+        return hash_combine(hash_bytes(class_file.data(), class_file.size()), hash_bytes(std::string(JJDE_VERSION "\n") + options));
+    }
+
+    std::optional<std::string> get(uint64_t key) {
+        std::filesystem::path path = entry_path(key);
+        std::ifstream stream(path, std::ios::binary);
+        if (!stream) return std::nullopt;
+
+        std::string header;
+        std::getline(stream, header);
+        std::istringstream fields(header);
+        std::string magic, version, stored_key;
+        std::size_t size = 0;
+        fields >> magic >> version >> stored_key >> size;
+        if (magic != "jjde-cache" || version != JJDE_VERSION || stored_key != hash_to_string(key)) return std::nullopt;
+
+        // The size is only trusted if it matches the rest of the file (corrupt entries are misses)
+        std::streamoff start = stream.tellg();
+        stream.seekg(0, std::ios::end);
+        std::streamoff end = stream.tellg();
+        if (!stream || start < 0 || end < start || (uint64_t) (end - start) != size) return std::nullopt;
+        stream.seekg(start);
+
+        std::string payload(size, '\0');
+        stream.read(&payload[0], (std::streamsize) size);
+        if ((std::size_t) stream.gcount() != size) return std::nullopt;
+
+        // Mark as recently used (failures only affect the eviction order)
+        std::error_code error;
+        std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+        return payload;
+    }
+
+    void put(uint64_t key, std::string const& payload) {
+        std::filesystem::path path = entry_path(key);
+        std::error_code error;
+        std::filesystem::create_directories(path.parent_path(), error);
+
+        // Unique temporary name per process and thread
+        std::ostringstream temporary_name;
+        temporary_name << path.filename().string() << ".tmp." << ::getpid() << "." << std::this_thread::get_id() << "." << counter++;
+        std::filesystem::path temporary = path.parent_path() / temporary_name.str();
+        {
+            std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+            stream << "jjde-cache " << JJDE_VERSION << " " << hash_to_string(key) << " " << payload.size() << "\n" << payload;
+            if (!stream) {
+                stream.close();
+                std::filesystem::remove(temporary, error);
+                return;
+            }
+        }
+        std::filesystem::rename(temporary, path, error);
+        if (error) {
+            std::filesystem::remove(temporary, error);
+            return;
+        }
+
+        if ((current_size += payload.size()) > max_size) evict();
+    }
+
+    // Remove least recently used entries until the cache is at 90% of its size limit
+    void evict() {
+        std::lock_guard<std::mutex> lock(eviction_mutex);
+        std::pair<std::vector<Entry>, uint64_t> contents = scan();
+        std::vector<Entry> & entries = contents.first;
+        uint64_t size = contents.second;
+        std::sort(entries.begin(), entries.end(), [](Entry const& a, Entry const& b) { return a.last_use < b.last_use; });
+        for (Entry const& entry : entries) {
+            if (size <= max_size / 10 * 9) break;
+            std::error_code error;
+            if (std::filesystem::remove(entry.path, error)) size -= entry.size;
+        }
+        current_size = size;
+    }
+
+private:
+    struct Entry {
+        std::filesystem::path path;
+        std::filesystem::file_time_type last_use;
+        uint64_t size;
+    };
+
+    std::filesystem::path directory;
+    uint64_t max_size;
+    std::atomic<uint64_t> current_size{0};
+    std::atomic<uint64_t> counter{0};
+    std::mutex eviction_mutex;
+
+    std::filesystem::path entry_path(uint64_t key) const {
+        std::string name = hash_to_string(key);
+        return directory / name.substr(0, 2) / name.substr(2);
+    }
+
+    std::pair<std::vector<Entry>, uint64_t> scan() const {
+        std::vector<Entry> entries;
+        uint64_t size = 0;
+        std::error_code error;
+        for (std::filesystem::recursive_directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+            std::error_code entry_error;
+            if (!it->is_regular_file(entry_error) || it->path().filename().string().find(".tmp.") != std::string::npos) continue;
+            Entry entry{it->path(), it->last_write_time(entry_error), it->file_size(entry_error)};
+            if (entry_error) continue; // Removed concurrently
+            size += entry.size;
+            entries.push_back(std::move(entry));
+        }
+        return std::make_pair(std::move(entries), size);
+    }
+};
+
+}
+
+#endif // JJDE_CACHE_HPP
@@ -0,0 +1,412 @@
+#ifndef JJDE_CALLGRAPH_HPP
+#define JJDE_CALLGRAPH_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "class.hpp"
+#include "corpus.hpp"
+#include "disassembler.hpp"
+#include "index.hpp"
+#include "instructions.hpp"
+
+namespace jjde {
+
+/* Call graph
+ *
+ * Every method that is declared in the corpus or called from it gets an ID. An edge from method a to
+ * method b means that the code of a contains an INVOKE* instruction that refers to b (the symbolic
+ * reference, as in the constant pool; virtual dispatch is not resolved). Call sites of INVOKEDYNAMIC
+ * have no owner class, and are recorded under the name and descriptor of the dynamic call site.
+ *
+ * Calls are extracted in parallel (one class at a time), and the graph is written to a file that is
+ * memory-mapped for queries, in the same way as the symbol index (see index.hpp).
+ *
+ * File layout (native byte order, every section aligned to 8 bytes):
+ *     CallGraphHeader
+ *     strings        (u4 length + bytes, referenced by offset)
+ *     methods        (CallGraphMethod[method_count])
+ *     callee offsets (u4[method_count + 1], CSR row offsets into callees)
+ *     callees        (CallGraphEdge[edge_count], sorted by caller)
+ *     caller offsets (u4[method_count + 1], CSR row offsets into callers)
+ *     callers        (CallGraphEdge[edge_count], sorted by callee)
+ *     method table   (u4[method_table_size], method index + 1, keyed by owner, name and descriptor)
+ */
+
+namespace detail {
+
+constexpr char CALL_GRAPH_MAGIC[8] = { 'J', 'J', 'D', 'E', 'C', 'G', 'R', '\0' };
+constexpr uint32_t CALL_GRAPH_VERSION = 1;
+
+struct CallGraphHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t method_count;
+    uint32_t edge_count;
+    uint32_t method_table_size; // Power of two
+    uint64_t strings_offset;
+    uint64_t strings_size;
+    uint64_t methods_offset;
+    uint64_t callee_offsets_offset;
+    uint64_t callees_offset;
+    uint64_t caller_offsets_offset;
+    uint64_t callers_offset;
+    uint64_t method_table_offset;
+};
+
+struct CallGraphMethod {
+    uint32_t owner; // Empty string for INVOKEDYNAMIC call sites
+    uint32_t name;
+    uint32_t descriptor;
+    uint32_t declared; // 1 if the method is declared in the corpus
+};
+
+struct CallGraphEdge {
+    uint32_t method;    // Callee (in callees) or caller (in callers)
+    uint32_t operation; // Instruction::Operation of the call site
+};
+
+}
+
+/* Extracting calls */
+
+struct Call {
+    std::string caller_name;
+    std::string caller_descriptor;
+    std::string owner; // Callee (dotted class name, empty for INVOKEDYNAMIC)
+    std::string name;
+    std::string descriptor;
+    Instruction::Operation operation;
+};
+
+struct ClassCalls {
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> methods; // Declared methods (name and descriptor)
+    std::vector<Call> calls; // In order, including duplicates
+};
+
+// All calls made by the methods of a class
+ClassCalls extract_calls(Class const& class_) {
+    ClassCalls result{class_.name, {}, {}};
+    std::vector<Call> & calls = result.calls;
+    std::vector<Constant> const& pool = class_.constants;
+    auto string_at = [&pool](uint16_t index) -> std::string const& {
+        if (index >= pool.size() || pool[index].type != Constant::STRING) throw std::logic_error("Invalid bytecode (bad method reference)");
+        return pool[index].value.string;
+    };
+    auto name_and_type = [&pool, &string_at](uint16_t index) {
+        if (index >= pool.size() || pool[index].type != Constant::NAME_TYPE_DESCRIPTOR) throw std::logic_error("Invalid bytecode (bad method reference)");
+        return std::make_pair(string_at(pool[index].value.pair_reference.first), string_at(pool[index].value.pair_reference.second));
+    };
+
+    for (Object const& method : class_.methods) {
+        result.methods.emplace_back(string_at(method.name_index), string_at(method.descriptor_index));
+        Attribute const* code = method.attribute(Attribute::CODE);
+        if (!code) continue;
+
+        std::string const& caller_name = string_at(method.name_index);
+        std::string const& caller_descriptor = string_at(method.descriptor_index);
+        for (Instruction const& instruction : disassemble(code->data).instructions) {
+            switch (instruction.operation) {
+            case Instruction::INVOKEVIRTUAL:
+            case Instruction::INVOKESPECIAL:
+            case Instruction::INVOKESTATIC:
+            case Instruction::INVOKEINTERFACE: {
+                uint16_t index = parse<uint16_t>(convert<2>(instruction.arguments));
+                if (index >= pool.size() || (pool[index].type != Constant::METHOD_REFERENCE && pool[index].type != Constant::INTERFACE_METHOD_REFERENCE)) {
+                    throw std::logic_error("Invalid bytecode (bad method reference)");
+                }
+                uint16_t class_index = pool[index].value.pair_reference.first;
+                if (class_index >= pool.size() || pool[class_index].type != Constant::CLASS_REFERENCE) {
+                    throw std::logic_error("Invalid bytecode (bad method reference)");
+                }
+                std::string owner = string_at(pool[class_index].value.reference);
+                std::replace(owner.begin(), owner.end(), '/', '.');
+                std::pair<std::string, std::string> callee = name_and_type(pool[index].value.pair_reference.second);
+                calls.push_back(Call{caller_name, caller_descriptor, std::move(owner), std::move(callee.first), std::move(callee.second), instruction.operation});
+                break;
+            }
+            case Instruction::INVOKEDYMANIC: {
+                uint16_t index = parse<uint16_t>(convert<2>(instruction.arguments));
+                if (index >= pool.size() || pool[index].type != Constant::INVOKE_DYNAMIC) throw std::logic_error("Invalid bytecode (bad dynamic call site)");
+                std::pair<std::string, std::string> callee = name_and_type((uint16_t) (pool[index].value.invoke_dynamic & 0xFFFF));
+                calls.push_back(Call{caller_name, caller_descriptor, "", std::move(callee.first), std::move(callee.second), instruction.operation});
+                break;
+            }
+            default:
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+/* Building a call graph */
+
+class CallGraphBuilder {
+public:
+    // Returns false (and ignores the class) if a class with the same name was added before
+    bool add(ClassCalls const& class_) {
+        if (!classes.emplace(class_.name).second) return false;
+        for (std::pair<std::string, std::string> const& method : class_.methods) {
+            methods[method_id(class_.name, method.first, method.second)].declared = 1;
+        }
+        for (Call const& call : class_.calls) {
+            uint32_t caller = method_id(class_.name, call.caller_name, call.caller_descriptor);
+            uint32_t callee = method_id(call.owner, call.name, call.descriptor);
+            edges.push_back(std::make_tuple(caller, callee, (uint32_t) call.operation));
+        }
+        return true;
+    }
+
+    std::size_t method_count() const { return methods.size(); }
+
+    void write(std::string const& filename) {
+        // Each distinct call (caller, callee, instruction) is recorded once
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+        detail::CallGraphHeader header{};
+        std::memcpy(header.magic, detail::CALL_GRAPH_MAGIC, sizeof(header.magic));
+        header.version = detail::CALL_GRAPH_VERSION;
+        header.method_count = (uint32_t) methods.size();
+        header.edge_count = (uint32_t) edges.size();
+        header.method_table_size = detail::table_size(methods.size());
+
+        // CSR rows in both directions (edges are sorted by caller; callers are ordered by a counting sort)
+        std::vector<uint32_t> callee_offsets(methods.size() + 1, 0);
+        std::vector<uint32_t> caller_offsets(methods.size() + 1, 0);
+        std::vector<detail::CallGraphEdge> callees;
+        for (std::tuple<uint32_t, uint32_t, uint32_t> const& edge : edges) {
+            ++callee_offsets[std::get<0>(edge) + 1];
+            ++caller_offsets[std::get<1>(edge) + 1];
+            callees.push_back(detail::CallGraphEdge{std::get<1>(edge), std::get<2>(edge)});
+        }
+        for (std::size_t id = 0; id < methods.size(); ++id) {
+            callee_offsets[id + 1] += callee_offsets[id];
+            caller_offsets[id + 1] += caller_offsets[id];
+        }
+        std::vector<detail::CallGraphEdge> callers(edges.size());
+        std::vector<uint32_t> next(caller_offsets.begin(), caller_offsets.end() - 1);
+        for (std::tuple<uint32_t, uint32_t, uint32_t> const& edge : edges) {
+            callers[next[std::get<1>(edge)]++] = detail::CallGraphEdge{std::get<0>(edge), std::get<2>(edge)};
+        }
+
+        std::vector<uint32_t> method_table(header.method_table_size, 0);
+        for (std::size_t index = 0; index < methods.size(); ++index) {
+            detail::CallGraphMethod const& method = methods[index];
+            detail::table_insert(method_table, detail::member_key(string_at(method.owner), string_at(method.name), string_at(method.descriptor)), (uint32_t) index);
+        }
+
+        // Section offsets
+        uint64_t offset = detail::align_section(sizeof(header));
+        header.strings_offset = offset;
+        header.strings_size = strings.size();
+        offset = detail::align_section(offset + strings.size());
+        header.methods_offset = offset;
+        offset = detail::align_section(offset + methods.size() * sizeof(detail::CallGraphMethod));
+        header.callee_offsets_offset = offset;
+        offset = detail::align_section(offset + callee_offsets.size() * sizeof(uint32_t));
+        header.callees_offset = offset;
+        offset = detail::align_section(offset + callees.size() * sizeof(detail::CallGraphEdge));
+        header.caller_offsets_offset = offset;
+        offset = detail::align_section(offset + caller_offsets.size() * sizeof(uint32_t));
+        header.callers_offset = offset;
+        offset = detail::align_section(offset + callers.size() * sizeof(detail::CallGraphEdge));
+        header.method_table_offset = offset;
+
+        std::ofstream stream(filename, std::ios::binary | std::ios::trunc);
+        if (!stream) throw std::runtime_error("Cannot write call graph " + filename);
+        detail::write_section(stream, &header, sizeof(header), 0);
+        detail::write_section(stream, strings.data(), strings.size(), header.strings_offset);
+        detail::write_section(stream, methods.data(), methods.size() * sizeof(detail::CallGraphMethod), header.methods_offset);
+        detail::write_section(stream, callee_offsets.data(), callee_offsets.size() * sizeof(uint32_t), header.callee_offsets_offset);
+        detail::write_section(stream, callees.data(), callees.size() * sizeof(detail::CallGraphEdge), header.callees_offset);
+        detail::write_section(stream, caller_offsets.data(), caller_offsets.size() * sizeof(uint32_t), header.caller_offsets_offset);
+        detail::write_section(stream, callers.data(), callers.size() * sizeof(detail::CallGraphEdge), header.callers_offset);
+        detail::write_section(stream, method_table.data(), method_table.size() * sizeof(uint32_t), header.method_table_offset);
+        if (!stream) throw std::runtime_error("Cannot write call graph " + filename);
+    }
+
+private:
+    std::string strings;
+    std::unordered_map<std::string, uint32_t> string_offsets;
+    std::unordered_set<std::string> classes;
+    std::vector<detail::CallGraphMethod> methods;
+    std::unordered_map<std::string, uint32_t> method_ids; // owner \0 name \0 descriptor
+    std::vector<std::tuple<uint32_t, uint32_t, uint32_t>> edges; // caller, callee, operation
+
+    uint32_t method_id(std::string const& owner, std::string const& name, std::string const& descriptor) {
+        std::string key = owner + '\0' + name + '\0' + descriptor;
+        auto it = method_ids.find(key);
+        if (it != method_ids.end()) return it->second;
+        uint32_t id = (uint32_t) methods.size();
+        methods.push_back(detail::CallGraphMethod{string(owner), string(name), string(descriptor), 0});
+        method_ids.emplace(std::move(key), id);
+        return id;
+    }
+
+    uint32_t string(std::string const& value) {
+        auto it = string_offsets.find(value);
+        if (it != string_offsets.end()) return it->second;
+        uint32_t offset = (uint32_t) strings.size();
+        uint32_t length = (uint32_t) value.size();
+        strings.append(reinterpret_cast<char const*>(&length), sizeof(length));
+        strings.append(value);
+        string_offsets.emplace(value, offset);
+        return offset;
+    }
+
+    std::string_view string_at(uint32_t offset) const {
+        uint32_t length;
+        std::memcpy(&length, strings.data() + offset, sizeof(length));
+        return std::string_view(strings.data() + offset + sizeof(length), length);
+    }
+};
+
+/* Reading a call graph */
+
+struct CallGraphNode {
+    uint32_t id;
+    std::string_view owner; // Empty for INVOKEDYNAMIC call sites
+    std::string_view name;
+    std::string_view descriptor;
+    bool declared; // Declared in the corpus (as opposed to only being called)
+};
+
+struct CallGraphEdge {
+    uint32_t method;
+    Instruction::Operation operation;
+};
+
+class CallGraph {
+public:
+    explicit CallGraph(std::string const& filename)
+        : file(filename) {
+        data = file.data();
+        if (file.size() < sizeof(detail::CallGraphHeader)) throw std::runtime_error("Invalid call graph " + filename);
+        header = reinterpret_cast<detail::CallGraphHeader const*>(data);
+        uint64_t rows = (uint64_t) header->method_count + 1;
+        if (std::memcmp(header->magic, detail::CALL_GRAPH_MAGIC, sizeof(header->magic)) != 0 || header->version != detail::CALL_GRAPH_VERSION
+                || !file.holds_section(header->strings_offset, header->strings_size)
+                || !file.holds_section(header->methods_offset, (uint64_t) header->method_count * sizeof(detail::CallGraphMethod))
+                || !file.holds_section(header->callee_offsets_offset, rows * sizeof(uint32_t))
+                || !file.holds_section(header->callees_offset, (uint64_t) header->edge_count * sizeof(detail::CallGraphEdge))
+                || !file.holds_section(header->caller_offsets_offset, rows * sizeof(uint32_t))
+                || !file.holds_section(header->callers_offset, (uint64_t) header->edge_count * sizeof(detail::CallGraphEdge))
+                || !file.holds_section(header->method_table_offset, (uint64_t) header->method_table_size * sizeof(uint32_t))
+                || !detail::is_table_size(header->method_table_size)) {
+            throw std::runtime_error("Invalid or incompatible call graph " + filename);
+        }
+        methods = reinterpret_cast<detail::CallGraphMethod const*>(data + header->methods_offset);
+        callee_offsets = reinterpret_cast<uint32_t const*>(data + header->callee_offsets_offset);
+        callees_ = reinterpret_cast<detail::CallGraphEdge const*>(data + header->callees_offset);
+        caller_offsets = reinterpret_cast<uint32_t const*>(data + header->caller_offsets_offset);
+        callers_ = reinterpret_cast<detail::CallGraphEdge const*>(data + header->callers_offset);
+        method_table = reinterpret_cast<uint32_t const*>(data + header->method_table_offset);
+    }
+
+    std::size_t method_count() const { return header->method_count; }
+    std::size_t edge_count() const { return header->edge_count; }
+
+    CallGraphNode method(uint32_t id) const {
+        detail::CallGraphMethod const& record = methods[detail::checked_index(id, header->method_count, "call graph")];
+        return CallGraphNode{id, string(record.owner), string(record.name), string(record.descriptor), record.declared != 0};
+    }
+
+    std::optional<CallGraphNode> find(std::string_view owner, std::string_view name, std::string_view descriptor) const {
+        std::size_t mask = header->method_table_size - 1;
+        // A corrupt table might have no empty slot, so no slot is probed twice
+        for (std::size_t slot = detail::member_key(owner, name, descriptor) & mask, probes = 0; probes <= mask && method_table[slot] != 0; slot = (slot + 1) & mask, ++probes) {
+            uint32_t id = detail::checked_index(method_table[slot] - 1, header->method_count, "call graph");
+            detail::CallGraphMethod const& record = methods[id];
+            if (string(record.name) == name && string(record.descriptor) == descriptor && string(record.owner) == owner) {
+                return method(id);
+            }
+        }
+        return std::nullopt;
+    }
+
+    // All overloads of a method (linear in the number of methods)
+    std::vector<CallGraphNode> find(std::string_view owner, std::string_view name) const {
+        std::vector<CallGraphNode> result;
+        for (uint32_t id = 0; id < header->method_count; ++id) {
+            if (string(methods[id].name) == name && string(methods[id].owner) == owner) result.push_back(method(id));
+        }
+        return result;
+    }
+
+    // Methods called by the given method
+    std::vector<CallGraphEdge> callees(uint32_t id) const {
+        return edges(callees_, callee_offsets, id);
+    }
+
+    // Methods that call the given method ("who calls X")
+    std::vector<CallGraphEdge> callers(uint32_t id) const {
+        return edges(callers_, caller_offsets, id);
+    }
+
+private:
+    detail::MappedFile file;
+    char const* data;
+    detail::CallGraphHeader const* header;
+    detail::CallGraphMethod const* methods;
+    uint32_t const* callee_offsets;
+    detail::CallGraphEdge const* callees_;
+    uint32_t const* caller_offsets;
+    detail::CallGraphEdge const* callers_;
+    uint32_t const* method_table;
+
+    std::string_view string(uint32_t offset) const {
+        return detail::checked_string(data + header->strings_offset, header->strings_size, offset, "call graph");
+    }
+
+    std::vector<CallGraphEdge> edges(detail::CallGraphEdge const* edges, uint32_t const* offsets, uint32_t id) const {
+        id = detail::checked_index(id, header->method_count, "call graph");
+        // Row offsets must be ordered and within the edges
+        uint32_t end = offsets[id + 1];
+        if (offsets[id] > end || end > header->edge_count) throw std::runtime_error("Corrupt call graph (row " + std::to_string(id) + ")");
+        std::vector<CallGraphEdge> result;
+        for (uint32_t edge = offsets[id]; edge < end; ++edge) {
+            uint32_t method = detail::checked_index(edges[edge].method, header->method_count, "call graph");
+            uint32_t operation = detail::checked_index(edges[edge].operation, INSTRUCTION_COUNT, "call graph");
+            result.push_back(CallGraphEdge{method, (Instruction::Operation) operation});
+        }
+        return result;
+    }
+};
+
+// Extract the calls of all classes of a corpus (in parallel) and write the call graph. Returns the number of methods.
+std::size_t build_call_graph(std::string const& corpus_path, std::string const& graph_path) {
+    Corpus corpus(corpus_path);
+
+    // Extraction is parallel; the graph is assembled in corpus order, so IDs are deterministic.
+    std::vector<std::pair<std::size_t, ClassCalls>> extracted = read_corpus(corpus, [](std::vector<unsigned char> const& bytes, std::size_t) {
+        return extract_calls(read_class(bytes));
+    });
+
+    CallGraphBuilder builder;
+    for (std::pair<std::size_t, ClassCalls> & entry : extracted) {
+        if (!builder.add(entry.second)) {
+            std::cerr << "Skipping duplicate class in " << corpus[entry.first].display_name() << std::endl;
+        }
+        entry.second = ClassCalls();
+    }
+    builder.write(graph_path);
+    return builder.method_count();
+}
+
+}
+
+#endif // JJDE_CALLGRAPH_HPP
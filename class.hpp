@@ -1,20 +1,29 @@
 #ifndef JJDE_CLASS_HPP
 #define JJDE_CLASS_HPP
 
+#include <algorithm>
 #include <cstdint>
 #include <fstream>
+#include <memory>
+#include <memory_resource>
+#include <string>
 #include <vector>
 
 #include "bytes.hpp"
 #include "constants.hpp"
 #include "flags.hpp"
 #include "objects.hpp"
+#include "stats.hpp"
 
 namespace jjde {
 
 struct Class {
+    // Backs the member and attribute lists and the attribute payloads, which are all released at once
+    // with the class (declared first, so it is destroyed last). Copies of a class use the default heap.
+    std::shared_ptr<std::pmr::monotonic_buffer_resource> arena;
+
     std::string name;
-    std::string parent;
+    std::string parent; // Empty for java.lang.Object
 
     struct {
         uint16_t major;
@@ -23,12 +32,82 @@ struct Class {
     std::vector<jjde::Constant> constants;
     jjde::Flags flags;
     std::vector<std::string> interfaces;
-    std::vector<jjde::Object> fields;
-    std::vector<jjde::Object> methods;
-    std::vector<jjde::Attribute> attributes;
+    jjde::ObjectList fields;
+    jjde::ObjectList methods;
+    jjde::AttributeList attributes;
+
+    // Decoded descriptors and signatures (shared between copies of this class)
+    std::shared_ptr<jjde::TypeCache> types;
+
+    // Kinds of the attribute names in the constant pool
+    jjde::AttributeKinds attribute_kinds;
+
+    // Rendered constant pool entries (shared between copies of this class)
+    std::shared_ptr<jjde::ConstantStrings> strings;
+
+    // Classes can be copied and moved, but not assigned: pmr lists keep their allocator on assignment,
+    // so assigning a class would copy its lists into the old (possibly freed) arena of the target.
+    // (Still an aggregate in C++17, since none of the constructors is user-provided.)
+    Class() = default;
+    Class(Class const&) = default;
+    Class(Class &&) = default;
+    Class & operator=(Class const&) = delete;
+    Class & operator=(Class &&) = delete;
+
+    // Decode the descriptor or signature stored in the given constant pool entry
+    jjde::TypeHandle type(uint16_t index) const {
+        return types->get(constants, index);
+    }
+
+    // Render the given constant pool entry
+    std::string const& constant(uint16_t index) const {
+        return strings->get(constants, index, types.get());
+    }
 };
 
-Class read_class(std::ifstream & stream) {
+// Class, name and descriptor of a method (such as "java.lang.Object.equals(Ljava/lang/Object;)Z")
+std::string qualified_method_name(Class const& class_, Object const& method) {
+    return class_.name + "." + class_.constants[method.name_index].value.string + class_.constants[method.descriptor_index].value.string;
+}
+
+/* Class headers
+ *
+ * Everything up to (and including) the interfaces, which is all that is needed to place a class in the
+ * class hierarchy. Reading a header does not touch fields, methods or attributes.
+ */
+
+struct ClassHeader {
+    std::string name;
+    std::string parent; // Empty for java.lang.Object
+
+    struct {
+        uint16_t major;
+        uint16_t minor;
+    } version;
+    std::vector<jjde::Constant> constants;
+    jjde::Flags flags;
+    std::vector<std::string> interfaces;
+};
+
+namespace detail {
+
+std::string read_class_name(std::istream & stream, std::vector<jjde::Constant> const& constants, char const* error) {
+    uint16_t class_ref_index = jjde::parse<uint16_t>(jjde::extract<2>(stream));
+    if (class_ref_index >= constants.size() || constants[class_ref_index].type != jjde::Constant::Type::CLASS_REFERENCE) {
+        throw std::logic_error(error);
+    }
+    uint16_t string_index = constants[class_ref_index].value.reference;
+    if (string_index >= constants.size() || constants[string_index].type != jjde::Constant::Type::STRING) {
+        throw std::logic_error(error);
+    }
+    std::string class_name = constants[string_index].value.string;
+    std::replace(class_name.begin(), class_name.end(), '/', '.');
+    return class_name;
+}
+
+}
+
+ClassHeader read_class_header(std::istream & stream) {
     // Extract and verify magic number (0xCAFEBABE)
 
     uint32_t magic = jjde::parse<uint32_t>(jjde::extract<4>(stream));
@@ -51,68 +130,93 @@ Class read_class(std::ifstream & stream) {
 
     // Extract name information about this class
 
-    uint16_t class_ref_index = jjde::parse<uint16_t>(jjde::extract<2>(stream));
-    if (constants[class_ref_index].type != jjde::Constant::Type::CLASS_REFERENCE) {
-        throw std::logic_error("Invalid bytecode (does not contain class name)");
-    }
-    uint16_t string_index = constants[class_ref_index].value.reference;
-    if (constants[string_index].type != jjde::Constant::Type::STRING) {
-        throw std::logic_error("Invalid bytecode (does not contain class name)");
-    }
-    std::string class_name = constants[string_index].value.string;
-    std::replace(class_name.begin(), class_name.end(), '/', '.');
-
+    std::string class_name = detail::read_class_name(stream, constants, "Invalid bytecode (does not contain class name)");
 
-    // Extract information about the parent class
+    // Extract information about the parent class (only java.lang.Object has none)
 
-    class_ref_index = jjde::parse<uint16_t>(jjde::extract<2>(stream));
-    if (constants[class_ref_index].type != jjde::Constant::Type::CLASS_REFERENCE) {
-        throw std::logic_error("Invalid bytecode (does not contain parent class name)");
+    std::string parent_class_name;
+    std::streampos parent_position = stream.tellg();
+    if (jjde::parse<uint16_t>(jjde::extract<2>(stream)) != 0) {
+        stream.seekg(parent_position);
+        parent_class_name = detail::read_class_name(stream, constants, "Invalid bytecode (does not contain parent class name)");
     }
-    string_index = constants[class_ref_index].value.reference;
-    if (constants[string_index].type != jjde::Constant::Type::STRING) {
-        throw std::logic_error("Invalid bytecode (does not contain parent class name)");
-    }
-    std::string parent_class_name = constants[string_index].value.string;
-    std::replace(parent_class_name.begin(), parent_class_name.end(), '/', '.');
 
     // Extract interfaces
 
     uint16_t interface_count = jjde::parse<uint16_t>(jjde::extract<2>(stream));
+    std::vector<std::string> interfaces;
+    for (uint16_t interface_id = 0; interface_id < interface_count; ++interface_id) {
+        interfaces.push_back(detail::read_class_name(stream, constants, "Invalid bytecode (interface name not set)"));
+    }
 
-    // Extract interfaces
+    return ClassHeader{std::move(class_name), std::move(parent_class_name), {major, minor}, std::move(constants), class_flags, std::move(interfaces)};
+}
 
-    std::vector<std::string> interfaces;
+ClassHeader read_class_header(std::vector<unsigned char> const& data) {
+    jjde::MemoryBuffer buffer(data.data(), data.size());
+    std::istream stream(&buffer);
+    return read_class_header(stream);
+}
 
-    for (uint16_t interface_id = 0; interface_id < interface_count; ++interface_id) {
-        class_ref_index = jjde::parse<uint16_t>(jjde::extract<2>(stream));
-        if (constants[class_ref_index].type != jjde::Constant::Type::CLASS_REFERENCE) {
-            throw std::logic_error("Invalid bytecode (interface name not set)");
+// Compares each string constant with the well-known attribute names once
+jjde::AttributeKinds resolve_attribute_kinds(std::vector<jjde::Constant> const& constants) {
+    jjde::AttributeKinds kinds(constants.size(), jjde::Attribute::OTHER);
+    for (std::size_t index = 0; index < constants.size(); ++index) {
+        if (constants[index].type != jjde::Constant::Type::STRING) continue;
+        std::string const& name = constants[index].value.string;
+        for (std::size_t kind = 0; kind < jjde::Attribute::OTHER; ++kind) {
+            if (name == jjde::Attribute::names[kind]) {
+                kinds[index] = (jjde::Attribute::Kind) kind;
+                break;
+            }
         }
-        string_index = constants[class_ref_index].value.reference;
-        if (constants[string_index].type != jjde::Constant::Type::STRING) {
-            throw std::logic_error("Invalid bytecode (interface name not set)");
+    }
+    return kinds;
+}
+
+// If attribute names are given, only those attributes are kept (see scan_class). The arena of the class
+// starts with initial_arena_size bytes and grows as needed.
+Class read_class(std::istream & stream, std::vector<std::string> const* attribute_names = nullptr, std::size_t initial_arena_size = 4096) {
+    JJDE_STATS_TIME(READ_CLASS);
+    ClassHeader header = read_class_header(stream);
+
+    std::unique_ptr<jjde::AttributeFilter> filter;
+    if (attribute_names) {
+        filter.reset(new jjde::AttributeFilter(header.constants.size(), false));
+        for (std::size_t index = 0; index < header.constants.size(); ++index) {
+            jjde::Constant const& constant = header.constants[index];
+            if (constant.type == jjde::Constant::Type::STRING && std::find(attribute_names->begin(), attribute_names->end(), constant.value.string) != attribute_names->end()) {
+                (*filter)[index] = true;
+            }
         }
-        std::string interface_name = constants[string_index].value.string;
-        std::replace(interface_name.begin(), interface_name.end(), '/', '.');
-        interfaces.push_back(interface_name);
     }
 
+    std::shared_ptr<std::pmr::monotonic_buffer_resource> arena = std::make_shared<std::pmr::monotonic_buffer_resource>(initial_arena_size);
+
     // Extract fields
 
-    std::vector<jjde::Object> fields = jjde::read_object_block(stream);
+    jjde::ObjectList fields = jjde::read_object_block(stream, jjde::Flags::FIELD, filter.get(), arena.get());
 
     // Extract methods
 
-    std::vector<jjde::Object> methods = jjde::read_object_block(stream);
+    jjde::ObjectList methods = jjde::read_object_block(stream, jjde::Flags::METHOD, filter.get(), arena.get());
 
     // Extract attributes
 
-    std::vector<jjde::Attribute> attributes = jjde::read_attribute_block(stream);
+    jjde::AttributeList attributes = jjde::read_attribute_block(stream, filter.get(), arena.get());
+
+    // Resolve attribute kinds
+
+    jjde::AttributeKinds kinds = resolve_attribute_kinds(header.constants);
+    for (jjde::Object & field : fields) field.index_attributes(kinds);
+    for (jjde::Object & method : methods) method.index_attributes(kinds);
 
     // Make class object
 
-    return Class{class_name, parent_class_name, {major, minor}, constants, class_flags, interfaces, fields, methods, attributes};
+    std::shared_ptr<jjde::TypeCache> types = std::make_shared<jjde::TypeCache>(header.constants.size());
+    std::shared_ptr<jjde::ConstantStrings> strings = std::make_shared<jjde::ConstantStrings>(header.constants.size());
+    return Class{std::move(arena), std::move(header.name), std::move(header.parent), {header.version.major, header.version.minor}, std::move(header.constants),
+                 header.flags, std::move(header.interfaces), std::move(fields), std::move(methods), std::move(attributes), types, std::move(kinds), std::move(strings)};
 }
 
 Class read_class(std::string const& filename) {
@@ -120,6 +224,30 @@ Class read_class(std::string const& filename) {
     return read_class(stream);
 }
 
+Class read_class(std::vector<unsigned char> const& data) {
+    JJDE_STATS_COUNT(BYTES_READ, data.size());
+    jjde::MemoryBuffer buffer(data.data(), data.size());
+    std::istream stream(&buffer);
+    // Most of a class file ends up in the arena (attribute payloads make up the bulk of it)
+    return read_class(stream, nullptr, data.size() + 1024);
+}
+
+/* Scanning classes
+ *
+ * Like read_class, but the payloads of all attributes except the requested ones (by default, those
+ * needed to list the class and its members with their generic types and constant values) are skipped.
+ * In particular, methods have no Code attribute.
+ */
+
+std::vector<std::string> const default_scan_attributes = {"Signature", "ConstantValue"};
+
+Class scan_class(std::vector<unsigned char> const& data, std::vector<std::string> const& attribute_names = default_scan_attributes) {
+    JJDE_STATS_COUNT(BYTES_READ, data.size());
+    jjde::MemoryBuffer buffer(data.data(), data.size());
+    std::istream stream(&buffer);
+    return read_class(stream, &attribute_names);
+}
+
 }
 
 #endif // JJDE_CLASS_HPP
@@ -1,54 +1,40 @@
 #ifndef JJDE_CONSTANTS_HPP
 #define JJDE_CONSTANTS_HPP
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <fstream>
 #include <iostream>
 #include <memory>
 #include <sstream>
+#include <stdexcept>
 #include <utility>
 #include <vector>
 
 #include "bytes.hpp"
+#include "stats.hpp"
+#include "type_table.hpp"
 #include "types.hpp"
 
 namespace jjde {
 
+// Quoted string literal (see append_escaped)
 std::string encode(std::string const& data) {
-    std::stringstream output;
-    output << "\"" << std::oct;
-    for (char c : data) {
-        if (c == '"') output << "\\\"";
-        else if (c == '\\') output << "\\\\";
-        else if (32 <= c && c <= 126) output << c;
-        else if (c == '\t') output << "\\t";
-        else if (c == '\b') output << "\\b";
-        else if (c == '\n') output << "\\n";
-        else if (c == '\r') output << "\\r";
-        else if (c == '\f') output << "\\f";
-        else {
-            int value = c;
-            if (value < 0) value += 256;
-            if (value < 8) output << "\\00" << value;
-            if (value < 64) output << "\\0" << value;
-            else output << "\\" << value;
-        }
-    }
-    output << "\"";
-    return output.str();
+    std::string output;
+    append_escaped(output, data.data(), data.size());
+    return output;
 }
 
 std::string convert_java_string(std::vector<unsigned char> const& string) {
-    std::stringstream stream;
     // TODO: Special java string encoding
-    for (unsigned char c : string) {
-        stream << (char) c;
-    }
-    return stream.str();
+    return std::string(string.begin(), string.end());
 }
 
 /* Constants */
 
+class TypeCache;
+
 struct Constant {
     enum Type {
         EMPTY = 0,
@@ -81,34 +67,179 @@ struct Constant {
     };
 
     Constant() : type(Type::EMPTY) {}
-    Constant(Type t, Value v) : type(t), value(v) {}
+    Constant(Type t, Value v) : type(t), value(std::move(v)) {}
 
     Type type;
     Value value;
 
-    std::string to_string(std::vector<Constant> const& pool) const {
-        switch (type) {
-        case EMPTY:                      return "<! empty !>";
-        case STRING:                     return encode(value.string);
-        case INTEGER:                    return std::to_string(value.integer);
-        case FLOAT:                      return std::to_string(value.float_);
-        case LONG:                       return std::to_string(value.long_);
-        case DOUBLE:                     return std::to_string(value.double_);
-        case CLASS_REFERENCE:            return decode_class_name(pool[value.reference].to_string(pool));
-        case STRING_REFERENCE:           return pool[value.reference].to_string(pool);
-        case FIELD_REFERENCE:            return "field \"" + pool[value.pair_reference.second].to_string(pool) + "\" of class " + pool[value.pair_reference.first].to_string(pool);
-        case METHOD_REFERENCE:           return "method \"" + pool[value.pair_reference.second].to_string(pool) + "\" of class " + pool[value.pair_reference.first].to_string(pool);
-        case INTERFACE_METHOD_REFERENCE: return "interface method \"" + pool[value.pair_reference.second].to_string(pool) + "\" of class " + pool[value.pair_reference.first].to_string(pool);
-        case NAME_TYPE_DESCRIPTOR:       return decode_type(pool[value.pair_reference.second].value.string).to_string(pool[value.pair_reference.first].value.string);
-        case METHOD_HANDLE:              return "<! method handle !>";
-        case METHOD_TYPE:                return "<! method type !>";
-        case INVOKE_DYNAMIC:             return "<! INVOKE_DYNAMIC !>";
-        default:                         return "<! invalid type !>";
+    // If a type cache is given, descriptors are taken from (and added to) the cache
+    std::string to_string(std::vector<Constant> const& pool, TypeCache const* types = nullptr) const;
+};
+
+/* Decoded descriptors and signatures
+ *
+ * Each STRING constant that is used as a descriptor or signature is resolved to an interned type at
+ * most once per class. Lookups may happen concurrently from multiple threads without locking; if two
+ * threads resolve the same entry at the same time, both obtain the same handle from the TypeTable.
+ */
+
+class TypeCache {
+public:
+    explicit TypeCache(std::size_t pool_size)
+        : handles(new std::atomic<TypeHandle>[pool_size])
+        , size(pool_size) {
+        for (std::size_t index = 0; index < size; ++index) {
+            handles[index].store(TypeHandle(), std::memory_order_relaxed);
+        }
+    }
+
+    TypeHandle get(std::vector<Constant> const& pool, uint16_t index) const {
+        if (index >= size || index >= pool.size() || pool[index].type != Constant::STRING) {
+            throw std::logic_error("Invalid descriptor index " + std::to_string(index));
         }
+        TypeHandle handle = handles[index].load(std::memory_order_acquire);
+        if (!handle) {
+            handle = intern_type(pool[index].value.string);
+            handles[index].store(handle, std::memory_order_release);
+        }
+        return handle;
     }
+
+private:
+    std::unique_ptr<std::atomic<TypeHandle>[]> handles;
+    std::size_t size;
 };
 
-std::pair<Constant, bool> read_constant(std::ifstream & stream) {
+/* Rendered constants
+ *
+ * The rendered form of each constant pool entry, computed on first use. References to other entries are
+ * followed through the cache, so an entry that is referenced by many instructions is only rendered once.
+ * Like the TypeCache, the cache may be filled concurrently without locking; if two threads render the
+ * same entry at the same time, one of the (equal) strings is kept.
+ *
+ * Entries that refer (directly or indirectly) to themselves are rendered as "<! cyclic reference !>"
+ * instead of recursing without bound. Renderings that depend on such a cycle are only cached for the
+ * entry that was requested (the others render differently depending on where the cycle was entered).
+ */
+
+class ConstantStrings {
+public:
+    explicit ConstantStrings(std::size_t pool_size)
+        : strings(new std::atomic<std::string const*>[pool_size])
+        , size(pool_size) {
+        for (std::size_t index = 0; index < size; ++index) {
+            strings[index].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~ConstantStrings() {
+        for (std::size_t index = 0; index < size; ++index) {
+            delete strings[index].load(std::memory_order_relaxed);
+        }
+    }
+
+    ConstantStrings(ConstantStrings const&) = delete;
+    ConstantStrings & operator=(ConstantStrings const&) = delete;
+
+    std::string const& get(std::vector<Constant> const& pool, uint16_t index, TypeCache const* types = nullptr) const {
+        if (index >= size || index >= pool.size()) throw std::out_of_range("Invalid constant index " + std::to_string(index));
+        std::string const* string = strings[index].load(std::memory_order_acquire);
+        if (string) return *string;
+        std::vector<uint16_t> visiting;
+        bool cyclic = false;
+        return store(index, render(pool, index, types, visiting, cyclic));
+    }
+
+    // Render an entry that is not necessarily part of a cached pool (through this cache, if given)
+    static std::string render_constant(Constant const& constant, std::vector<Constant> const& pool, TypeCache const* types, ConstantStrings const* cache) {
+        std::vector<uint16_t> visiting;
+        bool cyclic = false;
+        return render_value(constant, pool, types, cache, visiting, cyclic);
+    }
+
+private:
+    std::unique_ptr<std::atomic<std::string const*>[]> strings;
+    std::size_t size;
+
+    std::string const& store(uint16_t index, std::string rendered) const {
+        std::string const* string = new std::string(std::move(rendered));
+        std::string const* expected = nullptr;
+        if (!strings[index].compare_exchange_strong(expected, string, std::memory_order_acq_rel)) {
+            delete string;
+            return *expected;
+        }
+        return *string;
+    }
+
+    std::string render(std::vector<Constant> const& pool, uint16_t index, TypeCache const* types, std::vector<uint16_t> & visiting, bool & cyclic) const {
+        if (std::find(visiting.begin(), visiting.end(), index) != visiting.end()) {
+            cyclic = true;
+            return "<! cyclic reference !>";
+        }
+        std::string const* string = strings[index].load(std::memory_order_acquire);
+        if (string) return *string;
+        visiting.push_back(index);
+        bool inner_cyclic = false;
+        std::string rendered = render_value(pool[index], pool, types, this, visiting, inner_cyclic);
+        visiting.pop_back();
+        if (inner_cyclic) {
+            cyclic = true;
+            return rendered;
+        }
+        return store(index, std::move(rendered));
+    }
+
+    static std::string render_value(Constant const& constant, std::vector<Constant> const& pool, TypeCache const* types, ConstantStrings const* cache,
+                                    std::vector<uint16_t> & visiting, bool & cyclic) {
+        Constant::Value const& value = constant.value;
+        auto reference = [&](uint16_t index) -> std::string {
+            if (index >= pool.size()) return "<! invalid reference !>";
+            if (cache) return cache->render(pool, index, types, visiting, cyclic);
+            // Without a cache, only cycles are detected
+            if (std::find(visiting.begin(), visiting.end(), index) != visiting.end()) {
+                cyclic = true;
+                return "<! cyclic reference !>";
+            }
+            visiting.push_back(index);
+            std::string rendered = render_value(pool[index], pool, types, nullptr, visiting, cyclic);
+            visiting.pop_back();
+            return rendered;
+        };
+        auto string = [&](uint16_t index) -> std::string const* {
+            return (index < pool.size() && pool[index].type == Constant::STRING) ? &pool[index].value.string : nullptr;
+        };
+        switch (constant.type) {
+        case Constant::EMPTY:                      return "<! empty !>";
+        case Constant::STRING:                     return encode(value.string);
+        case Constant::INTEGER:                    return std::to_string(value.integer);
+        case Constant::FLOAT:                      return std::to_string(value.float_);
+        case Constant::LONG:                       return std::to_string(value.long_);
+        case Constant::DOUBLE:                     return std::to_string(value.double_);
+        case Constant::CLASS_REFERENCE:            return decode_class_name(reference(value.reference));
+        case Constant::STRING_REFERENCE:           return reference(value.reference);
+        case Constant::FIELD_REFERENCE:            return "field \"" + reference(value.pair_reference.second) + "\" of class " + reference(value.pair_reference.first);
+        case Constant::METHOD_REFERENCE:           return "method \"" + reference(value.pair_reference.second) + "\" of class " + reference(value.pair_reference.first);
+        case Constant::INTERFACE_METHOD_REFERENCE: return "interface method \"" + reference(value.pair_reference.second) + "\" of class " + reference(value.pair_reference.first);
+        case Constant::NAME_TYPE_DESCRIPTOR: {
+            std::string const* name = string(value.pair_reference.first);
+            std::string const* descriptor = string(value.pair_reference.second);
+            if (!name || !descriptor) return "<! invalid reference !>";
+            if (types) return types->get(pool, value.pair_reference.second)->to_string(*name);
+            return intern_type(*descriptor)->to_string(*name);
+        }
+        case Constant::METHOD_HANDLE:              return "<! method handle !>";
+        case Constant::METHOD_TYPE:                return "<! method type !>";
+        case Constant::INVOKE_DYNAMIC:             return "<! INVOKE_DYNAMIC !>";
+        default:                                   return "<! invalid type !>";
+        }
+    }
+};
+
+std::string Constant::to_string(std::vector<Constant> const& pool, TypeCache const* types) const {
+    return ConstantStrings::render_constant(*this, pool, types, nullptr);
+}
+
+std::pair<Constant, bool> read_constant(std::istream & stream) {
     Constant::Type type = (Constant::Type) parse<uint8_t>(extract<1>(stream));
     bool skip = (type == Constant::Type::LONG || type == Constant::Type::DOUBLE);
     uint16_t string_length, ref1, ref2;
@@ -117,7 +248,8 @@ std::pair<Constant, bool> read_constant(std::ifstream & stream) {
     case Constant::Type::STRING:
         // u2 string length + mUTF-8 string
         string_length = parse<uint16_t>(extract<2>(stream));
-        value.string = convert_java_string(extract(stream, string_length));
+        value.string.resize(string_length); // TODO: Special java string encoding (see convert_java_string)
+        stream.read(&value.string[0], string_length);
         break;
     case Constant::Type::INTEGER:
         // s4 integer
@@ -168,14 +300,16 @@ std::pair<Constant, bool> read_constant(std::ifstream & stream) {
     default:
         throw std::logic_error("Unknown constant type " + std::to_string((unsigned int) type));
     }
-    return std::pair<Constant, bool>(Constant(type, value), skip);
+    return std::pair<Constant, bool>(Constant(type, std::move(value)), skip);
 }
 
-std::vector<Constant> read_constant_block(std::ifstream & stream) {
+std::vector<Constant> read_constant_block(std::istream & stream) {
+    JJDE_STATS_TIME(CONSTANTS);
     uint16_t count = parse<uint16_t>(extract<2>(stream));
     bool skip = false;
 
     std::vector<Constant> constants = {Constant()}; // Initialize with an empty constant, since Java starts counting at 1.
+    constants.reserve(count);
 
     for (uint16_t id = 1; id < count; ++id) {
         if (skip) {
@@ -186,10 +320,11 @@ std::vector<Constant> read_constant_block(std::ifstream & stream) {
 
         std::pair<Constant, bool> result = read_constant(stream);
 
-        constants.push_back(result.first);
+        constants.push_back(std::move(result.first));
         skip = result.second;
     }
 
+    JJDE_STATS_COUNT(CONSTANTS_DECODED, constants.size() - 1);
     return constants;
 }
 
@@ -0,0 +1,31 @@
+#ifndef JJDE_CONTEXT_HPP
+#define JJDE_CONTEXT_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "class.hpp"
+#include "disassembler.hpp"
+
+namespace jjde {
+
+/* Method context
+ *
+ * The code of a method together with the class it belongs to. Both are referenced, not copied, so a
+ * context is cheap to create and pass around, but it must not outlive the class or the bytecode.
+ */
+
+struct MethodContext {
+    Class const& class_;
+    Bytecode const& bytecode;
+    bool static_;
+
+    // Rendered constant pool entry
+    std::string const& constant(uint16_t index) const {
+        return class_.constant(index);
+    }
+};
+
+}
+
+#endif // JJDE_CONTEXT_HPP
@@ -0,0 +1,251 @@
+#ifndef JJDE_CORPUS_HPP
+#define JJDE_CORPUS_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <zlib.h>
+
+#include "bytes.hpp"
+#include "parallel.hpp"
+
+namespace jjde {
+
+/* Class file corpora
+ *
+ * A corpus is a single class file (whatever its name), a jar (or zip) file, or a directory, which is
+ * searched recursively for class files and jar files (by suffix). Listing a corpus only reads directory entries and the central
+ * directories of the archives; the class files themselves are read on demand with Corpus::read, which
+ * may be called from several threads at once.
+ *
+ * Entries are listed in a fixed order (files sorted by path, archive members in directory order). As on
+ * a class path, where several entries define a class with the same name, the first one wins.
+ */
+
+struct CorpusEntry {
+    std::string name;    // Path of the class file, or path inside the archive
+    std::string archive; // Path of the containing archive (empty for plain class files)
+
+    // For archive members
+    uint16_t compression = 0;
+    uint32_t compressed_size = 0;
+    uint32_t size = 0;
+    uint32_t header_offset = 0;
+
+    // "archive!name" for archive members, the path otherwise
+    std::string display_name() const {
+        return archive.empty() ? name : archive + "!" + name;
+    }
+};
+
+namespace detail {
+
+inline uint16_t little_u16(unsigned char const* data) {
+    return (uint16_t) (data[0] | (data[1] << 8));
+}
+
+inline uint32_t little_u32(unsigned char const* data) {
+    return (uint32_t) data[0] | ((uint32_t) data[1] << 8) | ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24);
+}
+
+inline bool has_suffix(std::string const& string, std::string const& suffix) {
+    return string.size() >= suffix.size() && string.compare(string.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Read the central directory of a zip archive (JAR files are zip archives)
+inline void list_archive(std::string const& path, std::vector<CorpusEntry> & entries) {
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) throw std::runtime_error("Cannot open archive " + path);
+    stream.seekg(0, std::ios::end);
+    std::size_t file_size = (std::size_t) stream.tellg();
+
+    // The end of central directory record (22 bytes) is followed by a comment of up to 65535 bytes
+    std::size_t tail_size = std::min<std::size_t>(file_size, 22 + 65535);
+    std::vector<unsigned char> tail(tail_size);
+    stream.seekg(file_size - tail_size);
+    stream.read(reinterpret_cast<char *>(tail.data()), tail_size);
+
+    std::size_t record = std::string::npos;
+    for (std::size_t offset = tail_size >= 22 ? tail_size - 22 + 1 : 0; offset-- > 0;) {
+        if (little_u32(&tail[offset]) == 0x06054B50) {
+            record = offset;
+            break;
+        }
+    }
+    if (record == std::string::npos) throw std::runtime_error("Invalid archive (no end of central directory) " + path);
+
+    uint16_t count = little_u16(&tail[record + 10]);
+    uint32_t directory_size = little_u32(&tail[record + 12]);
+    uint32_t directory_offset = little_u32(&tail[record + 16]);
+    if (count == 0xFFFF || directory_offset == 0xFFFFFFFF) throw std::runtime_error("ZIP64 archives are not supported: " + path);
+
+    std::vector<unsigned char> directory(directory_size);
+    stream.seekg(directory_offset);
+    stream.read(reinterpret_cast<char *>(directory.data()), directory_size);
+    if (!stream) throw std::runtime_error("Invalid archive (truncated central directory) " + path);
+
+    std::size_t offset = 0;
+    for (uint16_t index = 0; index < count; ++index) {
+        if (offset + 46 > directory.size() || little_u32(&directory[offset]) != 0x02014B50) {
+            throw std::runtime_error("Invalid archive (corrupt central directory) " + path);
+        }
+        unsigned char const* header = &directory[offset];
+        uint16_t name_length = little_u16(header + 28);
+        uint16_t extra_length = little_u16(header + 30);
+        uint16_t comment_length = little_u16(header + 32);
+        std::string name(reinterpret_cast<char const*>(header + 46), name_length);
+        if (has_suffix(name, ".class")) {
+            CorpusEntry entry;
+            entry.name = name;
+            entry.archive = path;
+            entry.compression = little_u16(header + 10);
+            entry.compressed_size = little_u32(header + 20);
+            entry.size = little_u32(header + 24);
+            entry.header_offset = little_u32(header + 42);
+            entries.push_back(std::move(entry));
+        }
+        offset += 46 + name_length + extra_length + comment_length;
+    }
+}
+
+inline std::vector<unsigned char> inflate_raw(std::vector<unsigned char> & compressed, std::size_t size, std::string const& name) {
+    std::vector<unsigned char> output(size);
+    z_stream zstream{};
+    zstream.next_in = compressed.data();
+    zstream.avail_in = (uInt) compressed.size();
+    zstream.next_out = output.data();
+    zstream.avail_out = (uInt) output.size();
+    if (inflateInit2(&zstream, -MAX_WBITS) != Z_OK) throw std::runtime_error("Cannot initialize zlib");
+    int result = inflate(&zstream, Z_FINISH);
+    inflateEnd(&zstream);
+    if (result != Z_STREAM_END || zstream.total_out != size) throw std::runtime_error("Cannot decompress " + name);
+    return output;
+}
+
+}
+
+class Corpus {
+public:
+    explicit Corpus(std::string const& path) {
+        namespace fs = std::filesystem;
+        if (fs::is_directory(path)) {
+            std::vector<std::string> files;
+            for (fs::directory_entry const& entry : fs::recursive_directory_iterator(path)) {
+                if (entry.is_regular_file()) files.push_back(entry.path().string());
+            }
+            // Directory iteration order is unspecified
+            std::sort(files.begin(), files.end());
+            for (std::string const& file : files) add_file(file, false);
+        } else if (fs::exists(path)) {
+            add_file(path, true);
+        } else {
+            throw std::runtime_error("No such file or directory: " + path);
+        }
+    }
+
+    std::size_t size() const { return entries.size(); }
+    CorpusEntry const& operator[](std::size_t index) const { return entries[index]; }
+    std::vector<CorpusEntry>::const_iterator begin() const { return entries.begin(); }
+    std::vector<CorpusEntry>::const_iterator end() const { return entries.end(); }
+
+    // Read the contents of a class file (thread-safe)
+    std::vector<unsigned char> read(std::size_t index) const {
+        return read(entries.at(index));
+    }
+
+    static std::vector<unsigned char> read(CorpusEntry const& entry) {
+        if (entry.archive.empty()) {
+            std::ifstream stream(entry.name, std::ios::binary);
+            if (!stream) throw std::runtime_error("Cannot open " + entry.name);
+            return std::vector<unsigned char>(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        }
+
+        std::ifstream stream(entry.archive, std::ios::binary);
+        if (!stream) throw std::runtime_error("Cannot open archive " + entry.archive);
+        // Local file header (the lengths of the variable fields may differ from the central directory)
+        unsigned char header[30];
+        stream.seekg(entry.header_offset);
+        stream.read(reinterpret_cast<char *>(header), 30);
+        if (!stream || detail::little_u32(header) != 0x04034B50) throw std::runtime_error("Invalid archive entry " + entry.display_name());
+        stream.seekg(detail::little_u16(header + 26) + detail::little_u16(header + 28), std::ios::cur);
+
+        std::vector<unsigned char> data(entry.compressed_size);
+        stream.read(reinterpret_cast<char *>(data.data()), data.size());
+        if (!stream) throw std::runtime_error("Truncated archive entry " + entry.display_name());
+
+        switch (entry.compression) {
+        case 0: // Stored
+            return data;
+        case 8: // Deflated
+            return detail::inflate_raw(data, entry.size, entry.display_name());
+        default:
+            throw std::runtime_error("Unsupported compression method " + std::to_string(entry.compression) + " for " + entry.display_name());
+        }
+    }
+
+private:
+    std::vector<CorpusEntry> entries;
+
+    // Files found in a directory are skipped unless their suffix says what they are, but a file named
+    // explicitly is a class file unless it is an archive.
+    void add_file(std::string const& path, bool named) {
+        if (detail::has_suffix(path, ".jar") || detail::has_suffix(path, ".zip")) {
+            detail::list_archive(path, entries);
+        } else if (named || detail::has_suffix(path, ".class")) {
+            CorpusEntry entry;
+            entry.name = path;
+            entries.push_back(std::move(entry));
+        }
+    }
+};
+
+/* Reading every class of a corpus
+ *
+ * read_corpus(corpus, read) calls read(bytes, entry) for the bytes of every entry, in parallel, and
+ * returns the results with their entry indices, in corpus order. Entries that cannot be read (or that
+ * read throws for) are reported on std::cerr and left out. read is copied once per block of entries, so
+ * a mutable reader can keep scratch buffers between the entries of a block.
+ */
+
+template <typename Read>
+auto read_corpus(Corpus const& corpus, Read read, std::size_t block = 1)
+        -> std::vector<std::pair<std::size_t, std::invoke_result_t<Read &, std::vector<unsigned char> const&, std::size_t>>> {
+    using Result = std::invoke_result_t<Read &, std::vector<unsigned char> const&, std::size_t>;
+    std::vector<std::optional<Result>> results(corpus.size());
+    std::vector<std::string> errors(corpus.size());
+    parallel_for((corpus.size() + block - 1) / block, [&](std::size_t first) {
+        Read reader = read;
+        for (std::size_t index = first * block; index < std::min(corpus.size(), (first + 1) * block); ++index) {
+            try {
+                results[index] = reader(corpus.read(index), index);
+            } catch (std::exception const& error) {
+                errors[index] = error.what();
+            }
+        }
+    });
+
+    std::vector<std::pair<std::size_t, Result>> readable;
+    readable.reserve(corpus.size());
+    for (std::size_t index = 0; index < corpus.size(); ++index) {
+        if (results[index]) {
+            readable.emplace_back(index, std::move(*results[index]));
+        } else {
+            std::cerr << "Skipping " << corpus[index].display_name() << ": " << errors[index] << std::endl;
+        }
+    }
+    return readable;
+}
+
+}
+
+#endif // JJDE_CORPUS_HPP
@@ -0,0 +1,146 @@
+#ifndef JJDE_DEBUG_HPP
+#define JJDE_DEBUG_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bytes.hpp"
+#include "class.hpp"
+#include "disassembler.hpp"
+#include "objects.hpp"
+#include "type_table.hpp"
+
+namespace jjde {
+
+/* Debugging information
+ *
+ * Decodes the LineNumberTable and LocalVariableTable attributes of a method's code. Each table is only
+ * decoded (and sorted) the first time it is used; all lookups are binary searches. A method may have
+ * several attributes of each kind, their entries are merged.
+ */
+
+struct LineNumber {
+    uint32_t start; // Code offset of the first instruction of the line
+    uint16_t line;
+};
+
+struct LocalVariable {
+    uint32_t start; // The variable is live in [start, end)
+    uint32_t end;
+    uint16_t slot;
+    uint16_t name_index;       // for the constant pool
+    uint16_t descriptor_index; // for the constant pool
+};
+
+class DebugInfo {
+public:
+    // The attributes of the Code attribute; they must outlive the DebugInfo.
+    DebugInfo(AttributeList const& attributes_, AttributeKinds const& kinds_)
+        : attributes(attributes_)
+        , kinds(kinds_) {}
+
+    // Sorted by start offset
+    std::vector<LineNumber> const& lines() const {
+        if (!line_table) {
+            line_table.emplace();
+            for (Attribute const& attribute : attributes) {
+                if (attribute_kind(kinds, attribute) != Attribute::LINE_NUMBER_TABLE) continue;
+                std::size_t count = table_size(attribute, 4);
+                for (std::size_t entry = 0; entry < count; ++entry) {
+                    line_table->push_back(LineNumber{parse<uint16_t>(convert<2>(attribute.data, 2 + 4 * entry)), parse<uint16_t>(convert<2>(attribute.data, 4 + 4 * entry))});
+                }
+            }
+            std::stable_sort(line_table->begin(), line_table->end(), [](LineNumber const& a, LineNumber const& b) { return a.start < b.start; });
+        }
+        return *line_table;
+    }
+
+    // Sorted by slot, then by start offset
+    std::vector<LocalVariable> const& locals() const {
+        if (!local_table) {
+            local_table.emplace();
+            for (Attribute const& attribute : attributes) {
+                if (attribute_kind(kinds, attribute) != Attribute::LOCAL_VARIABLE_TABLE) continue;
+                std::size_t count = table_size(attribute, 10);
+                for (std::size_t entry = 0; entry < count; ++entry) {
+                    std::size_t offset = 2 + 10 * entry;
+                    uint16_t start = parse<uint16_t>(convert<2>(attribute.data, offset));
+                    uint16_t length = parse<uint16_t>(convert<2>(attribute.data, offset + 2));
+                    local_table->push_back(LocalVariable{start, (uint32_t) start + length,
+                                                         parse<uint16_t>(convert<2>(attribute.data, offset + 8)),
+                                                         parse<uint16_t>(convert<2>(attribute.data, offset + 4)),
+                                                         parse<uint16_t>(convert<2>(attribute.data, offset + 6))});
+                }
+            }
+            std::sort(local_table->begin(), local_table->end(), [](LocalVariable const& a, LocalVariable const& b) {
+                return a.slot != b.slot ? a.slot < b.slot : a.start < b.start;
+            });
+        }
+        return *local_table;
+    }
+
+    bool has_lines() const { return !lines().empty(); }
+
+    // Source line of the instruction at the given offset, if known
+    std::optional<uint16_t> line(uint32_t offset) const {
+        std::vector<LineNumber> const& table = lines();
+        auto it = std::upper_bound(table.begin(), table.end(), offset, [](uint32_t offset, LineNumber const& entry) { return offset < entry.start; });
+        if (it == table.begin()) return std::nullopt;
+        return std::prev(it)->line;
+    }
+
+    // Variable in the given slot at the given offset, or nullptr
+    LocalVariable const* local(uint16_t slot, uint32_t offset) const {
+        std::vector<LocalVariable> const& table = locals();
+        auto it = std::upper_bound(table.begin(), table.end(), std::make_pair(slot, offset), [](std::pair<uint16_t, uint32_t> const& key, LocalVariable const& entry) {
+            return key.first != entry.slot ? key.first < entry.slot : key.second < entry.start;
+        });
+        if (it == table.begin()) return nullptr;
+        --it;
+        return (it->slot == slot && it->start <= offset && offset < it->end) ? &*it : nullptr;
+    }
+
+private:
+    AttributeList const& attributes;
+    AttributeKinds const& kinds;
+    mutable std::optional<std::vector<LineNumber>> line_table;
+    mutable std::optional<std::vector<LocalVariable>> local_table;
+
+    // Number of entries of a table attribute (u2 count, then fixed-size entries)
+    static std::size_t table_size(Attribute const& attribute, std::size_t entry_size) {
+        if (attribute.data.size() < 2) throw std::logic_error("Invalid bytecode (truncated debugging information)");
+        std::size_t count = parse<uint16_t>(convert<2>(attribute.data));
+        if (attribute.data.size() < 2 + entry_size * count) throw std::logic_error("Invalid bytecode (truncated debugging information)");
+        return count;
+    }
+};
+
+// Names of a method's parameters from its LocalVariableTable (empty where unknown); the slots are
+// derived from the descriptor, on which two-word (long and double) parameters take two slots.
+std::vector<std::string> parameter_names(Class const& class_, Object const& method, std::size_t count) {
+    std::vector<std::string> names(count);
+    Attribute const* code = method.attribute(Attribute::CODE);
+    if (!code) return names;
+    AttributeList attributes = code_attributes(code->data);
+    DebugInfo debug(attributes, class_.attribute_kinds);
+    if (debug.locals().empty()) return names;
+
+    TypeHandle descriptor = class_.type(method.descriptor_index);
+    if (descriptor->argument_types.size() != count) return names; // The signature does not match the descriptor
+    uint16_t slot = method.flags.is_static() ? 0 : 1;
+    for (std::size_t index = 0; index < count; ++index) {
+        LocalVariable const* variable = debug.local(slot, 0);
+        if (variable) names[index] = class_.constants.at(variable->name_index).value.string;
+        TypeHandle type = descriptor->argument_types[index];
+        slot += (type->array_dimensions == 0 && (type->java_type == "long" || type->java_type == "double")) ? 2 : 1;
+    }
+    return names;
+}
+
+}
+
+#endif // JJDE_DEBUG_HPP
@@ -0,0 +1,189 @@
+#ifndef JJDE_DECOMPILER_HPP
+#define JJDE_DECOMPILER_HPP
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "analysis.hpp"
+#include "annotater.hpp"
+#include "class.hpp"
+#include "debug.hpp"
+#include "dedup.hpp"
+#include "disassembler.hpp"
+#include "index.hpp"
+#include "passes.hpp"
+#include "stats.hpp"
+
+namespace jjde {
+
+/* Attributes to check:
+ *     Code                Method code (+ more information)
+ *     ConstantValue       Constant values for primitve 'final' fields
+ *     Exceptions          Exceptions thrown by a method
+ *     InnerClasses        Inner classes
+ *     LineNumberTable     Line numbers (debugging information)
+ *     LocalVariableTable  Local variable names (debugging information)
+ *     SourceFile          Source code file name (.java)
+ *     Synthetic           Field or method is compiler-generated
+ */
+
+// Class name, parent and interfaces (without the opening brace)
+std::string class_declaration(Class const& class_) {
+    std::string output = class_.flags.to_string() + " class " + class_.name;
+    if (!class_.parent.empty() && class_.parent != "java.lang.Object") {
+        output += " extends " + class_.parent;
+    }
+    for (std::size_t index = 0; index < class_.interfaces.size(); ++index) {
+        output += (index == 0 ? " implements " : ", ") + class_.interfaces[index];
+    }
+    return output;
+}
+
+void write_field(std::ostream & output, Class const& class_, Object const& field) {
+    // Flags
+    std::string flags = field.flags.to_string();
+    if (flags.size() > 0) flags += " ";
+
+    // Type
+    std::string type = class_.type(field.descriptor_index)->to_string();
+    Attribute const* attribute = field.attribute(Attribute::SIGNATURE);
+    if (attribute) {
+        // Get signature instead of type (fixes generics type erasure)
+        type = class_.type(parse<uint16_t>(convert<2>(attribute->data)))->to_string();
+    }
+
+    // Name
+    std::string name = class_.constants[field.name_index].value.string;
+
+    // Output (without value)
+    output << "    " << flags << type << " " << name;
+
+    // Check for default value of primitive types in the ConstantValue attribute
+    attribute = field.attribute(Attribute::CONSTANT_VALUE);
+    if (attribute) {
+        output << " = " << class_.constant(parse<uint16_t>(convert<2>(attribute->data)));
+    }
+
+    output << ";" << std::endl;
+}
+
+// Flags and signature of a method (with generic types, if available)
+std::string method_declaration(Class const& class_, Object const& method) {
+    // Flags
+    std::string flags = method.flags.to_string();
+    if (flags.size() > 0) flags += " ";
+
+    // Name
+    std::string name = class_.constants[method.name_index].value.string;
+    std::string::size_type dollar = name.find("$"); // Function overloads are numbered using $0, $1, etc.
+    if (dollar != std::string::npos) {
+        name = name.substr(0, dollar);
+    }
+
+    // Type
+    TypeHandle jjde_type = class_.type(method.descriptor_index);
+    Attribute const* signature = method.attribute(Attribute::SIGNATURE);
+    if (signature) {
+        // Get signature instead of type (fixes generics type erasure)
+        jjde_type = class_.type(parse<uint16_t>(convert<2>(signature->data)));
+    }
+
+    //  - Get argument names (from the debugging information, if available)
+    std::vector<std::string> argument_names = parameter_names(class_, method, jjde_type->argument_types.size());
+    for (std::size_t index = 0; index < argument_names.size(); ++index) {
+        if (argument_names[index].empty()) argument_names[index] = "arg" + std::to_string(index);
+    }
+
+    //  - Get proper type
+    return flags + jjde_type->to_string(name, argument_names);
+}
+
+// With bodies, identical method bodies are only rendered once (see MethodBodies)
+void write_method(std::ostream & output, Class const& class_, Object const& method, SymbolIndex const* symbols = nullptr, MethodBodies * bodies = nullptr) {
+    JJDE_STATS_TIME_METHOD(qualified_method_name(class_, method));
+
+    // Output (without value)
+    output << "    " << method_declaration(class_, method);
+
+    // Output code
+    MethodAnalyses analyses(class_, method, symbols);
+    if (analyses.code) {
+        output << " {" << std::endl;
+        if (bodies) {
+            // A duplicate body is found from the disassembly alone, without rendering it again
+            std::string identity = MethodBodies::identity(class_, *analyses.code, analyses.get<passes::Disassembly>(), analyses.is_static());
+            std::shared_ptr<std::string const> body = bodies->get(identity);
+            if (!body) {
+                body = std::make_shared<std::string const>(analyses.get<passes::Rendering>());
+                bodies->put(identity, body);
+            }
+            output << *body;
+        } else {
+            output << analyses.get<passes::Rendering>();
+        }
+    } else {
+        output << " {}" << std::endl;
+    }
+
+    output << std::endl;
+}
+
+/* Write the declarations of a class and its members, without any code (see scan_class) */
+
+void write_outline(std::ostream & output, Class const& class_) {
+    output << class_declaration(class_) << " {" << std::endl;
+    for (Object const& field : class_.fields) {
+        write_field(output, class_, field);
+    }
+    for (Object const& method : class_.methods) {
+        output << "    " << method_declaration(class_, method) << ";" << std::endl;
+    }
+    output << "}" << std::endl;
+}
+
+/* Write the code flow graphs of all methods of a class, as "dot" (see write_dot) or "edges" (see write_edge_list) */
+
+void write_class_flows(std::ostream & output, Class const& class_, std::string const& format, FlagFilter const& filter = FlagFilter()) {
+    if (!filter.accepts(class_.flags)) return;
+    for (Object const& method : class_.methods) {
+        if (!filter.accepts(method.flags)) continue;
+        MethodAnalyses analyses(class_, method);
+        if (!analyses.code) continue;
+        std::string name = qualified_method_name(class_, method);
+        JJDE_STATS_TIME_METHOD(name);
+        char const* comment = (format == "dot") ? "// " : "# ";
+        try {
+            CodeFlow const& flow = analyses.get<passes::Flow>();
+            if (format == "dot") {
+                write_dot(output, flow, name);
+            } else {
+                output << comment << name << "\n";
+                write_edge_list(output, flow);
+            }
+        } catch (std::exception const& error) {
+            output << comment << name << ": " << error.what() << "\n";
+        }
+    }
+}
+
+/* Write the (annotated) java code of a class (nothing if the filter rejects the class) */
+
+void write_class(std::ostream & output, Class const& class_, SymbolIndex const* symbols = nullptr, MethodBodies * bodies = nullptr, FlagFilter const& filter = FlagFilter()) {
+    if (!filter.accepts(class_.flags)) return;
+    output << class_declaration(class_) << " {" << std::endl;
+    for (Object const& field : class_.fields) {
+        if (filter.accepts(field.flags)) write_field(output, class_, field);
+    }
+    for (Object const& method : class_.methods) {
+        if (filter.accepts(method.flags)) write_method(output, class_, method, symbols, bodies);
+    }
+    output << "}" << std::endl;
+}
+
+}
+
+#endif // JJDE_DECOMPILER_HPP
@@ -0,0 +1,99 @@
+#ifndef JJDE_DEDUP_HPP
+#define JJDE_DEDUP_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+#include "class.hpp"
+#include "disassembler.hpp"
+#include "fingerprint.hpp"
+#include "hash.hpp"
+
+namespace jjde {
+
+/* Method body deduplication
+ *
+ * Large corpora contain many identical method bodies (accessors, default constructors, copies of the
+ * same library in different jars). The rendered body of a method (annotated instructions, code
+ * summary and code flow) prints the raw code, including the constant pool indices in the operands,
+ * and the constants those indices refer to. Its identity is therefore the raw Code attribute plus the
+ * rendered form of every constant it refers to (and the names of its attributes); the body is only
+ * rendered for the first method with that identity. The declaration is still written per method.
+ *
+ * Bodies are found by a hash of the identity, and a hit is only used if the stored identity is equal,
+ * so a hash collision costs a rendering, not a wrong body. Shared by all render workers. Bodies are
+ * kept until the store is full (max_bytes, counting identities and bodies); after that, existing
+ * bodies are still reused, but new ones are no longer added.
+ */
+
+class MethodBodies {
+public:
+    explicit MethodBodies(uint64_t max_bytes_) : max_bytes(max_bytes_) {}
+
+    // Everything the rendered body of the method depends on
+    static std::string identity(Class const& class_, Attribute const& code, Bytecode const& bytecode, bool static_) {
+        std::string identity(1, static_ ? 's' : 'i');
+        identity.append(reinterpret_cast<char const*>(code.data.data()), code.data.size());
+        auto add = [&](std::string const& text) {
+            identity += '\0';
+            identity += text;
+        };
+        for (Instruction const& instruction : bytecode.instructions) {
+            std::size_t index_size = detail::pool_index_size(instruction.operation);
+            if (index_size == 1) add(class_.constant(instruction.arguments.at(0)));
+            else if (index_size == 2) add(class_.constant(parse<uint16_t>(convert<2>(instruction.arguments))));
+        }
+        for (ExceptionHandler const& handler : bytecode.exception_handlers) {
+            if (handler.exception != 0) add(class_.constant(handler.exception));
+        }
+        for (Attribute const& attribute : bytecode.attributes) {
+            add(class_.constants.at(attribute.name_index).value.string);
+        }
+        return identity;
+    }
+
+    std::shared_ptr<std::string const> get(std::string const& identity) {
+        ++methods;
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = bodies.find(hash_bytes(identity));
+        if (it == bodies.end() || it->second.identity != identity) return nullptr;
+        ++duplicates;
+        return it->second.body;
+    }
+
+    void put(std::string const& identity, std::shared_ptr<std::string const> body) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        uint64_t size = identity.size() + body->size();
+        if (used + size > max_bytes) return;
+        // On a hash collision, the first body is kept
+        if (bodies.emplace(hash_bytes(identity), Entry{identity, std::move(body)}).second) {
+            used += size;
+        }
+    }
+
+    // Methods with code that were looked up, and how many of them reused an earlier body
+    uint64_t method_count() const { return methods; }
+    uint64_t duplicate_count() const { return duplicates; }
+
+private:
+    struct Entry {
+        std::string identity;
+        std::shared_ptr<std::string const> body;
+    };
+
+    uint64_t max_bytes;
+    uint64_t used = 0;
+    std::unordered_map<uint64_t, Entry> bodies;
+    std::shared_mutex mutex;
+    std::atomic<uint64_t> methods{0};
+    std::atomic<uint64_t> duplicates{0};
+};
+
+}
+
+#endif // JJDE_DEDUP_HPP
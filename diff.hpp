@@ -0,0 +1,232 @@
+#ifndef JJDE_DIFF_HPP
+#define JJDE_DIFF_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "class.hpp"
+#include "corpus.hpp"
+#include "decompiler.hpp"
+#include "fingerprint.hpp"
+#include "index.hpp"
+#include "parallel.hpp"
+
+namespace jjde {
+
+/* Semantic differences between two versions of a corpus
+ *
+ * Both corpora are summarized in parallel: every class is parsed once, and each field and method is
+ * reduced to its fingerprint (see fingerprint.hpp). Classes are matched by name and members by name and
+ * descriptor. Only the classes that contain changes are read again, and only their added and changed
+ * methods are decompiled.
+ */
+
+struct MemberSummary {
+    std::string name;
+    std::string descriptor;
+    bool is_method;
+    std::size_t index; // In Class::fields or Class::methods
+    uint64_t fingerprint;
+
+    std::string key() const {
+        return name + (is_method ? "" : ":") + descriptor;
+    }
+};
+
+struct ClassSummary {
+    std::string name;
+    std::string declaration; // See class_declaration
+    std::size_t entry; // In the corpus
+    std::vector<MemberSummary> members;
+};
+
+struct MemberChange {
+    enum Kind { ADDED, REMOVED, CHANGED };
+    Kind kind;
+    MemberSummary const* old_member; // nullptr for ADDED
+    MemberSummary const* new_member; // nullptr for REMOVED
+};
+
+struct ClassChange {
+    enum Kind { ADDED, REMOVED, CHANGED };
+    Kind kind;
+    ClassSummary const* old_class; // nullptr for ADDED
+    ClassSummary const* new_class; // nullptr for REMOVED
+    std::vector<MemberChange> members;
+};
+
+struct CorpusDiff {
+    std::vector<ClassSummary> old_classes;
+    std::vector<ClassSummary> new_classes;
+    std::vector<ClassChange> changes; // In the order of the new corpus, followed by removed classes
+    std::size_t unchanged_classes = 0;
+};
+
+ClassSummary summarize_class(Class const& class_, std::size_t entry) {
+    ClassSummary summary{class_.name, class_declaration(class_), entry, {}};
+    for (std::size_t index = 0; index < class_.fields.size() + class_.methods.size(); ++index) {
+        bool is_method = index >= class_.fields.size();
+        std::size_t member_index = is_method ? index - class_.fields.size() : index;
+        Object const& member = is_method ? class_.methods[member_index] : class_.fields[member_index];
+        summary.members.push_back(MemberSummary{
+            class_.constants[member.name_index].value.string,
+            class_.constants[member.descriptor_index].value.string,
+            is_method,
+            member_index,
+            fingerprint_method(class_, member)
+        });
+    }
+    return summary;
+}
+
+// Summaries of the readable classes (see read_corpus)
+std::vector<ClassSummary> summarize_corpus(Corpus const& corpus) {
+    std::vector<ClassSummary> summaries;
+    for (auto & summary : read_corpus(corpus, [](std::vector<unsigned char> const& bytes, std::size_t entry) { return summarize_class(read_class(bytes), entry); })) {
+        summaries.push_back(std::move(summary.second));
+    }
+    return summaries;
+}
+
+namespace detail {
+
+// Index classes by name (keeps the first of several classes with the same name)
+std::unordered_map<std::string, ClassSummary const*> classes_by_name(std::vector<ClassSummary> const& classes) {
+    std::unordered_map<std::string, ClassSummary const*> map;
+    for (ClassSummary const& class_ : classes) map.emplace(class_.name, &class_);
+    return map;
+}
+
+ClassChange compare_classes(ClassSummary const& old_class, ClassSummary const& new_class) {
+    ClassChange change{ClassChange::CHANGED, &old_class, &new_class, {}};
+    std::unordered_map<std::string, MemberSummary const*> old_members;
+    for (MemberSummary const& member : old_class.members) old_members.emplace(member.key(), &member);
+    for (MemberSummary const& member : new_class.members) {
+        auto it = old_members.find(member.key());
+        if (it == old_members.end()) {
+            change.members.push_back(MemberChange{MemberChange::ADDED, nullptr, &member});
+            continue;
+        }
+        if (it->second->fingerprint != member.fingerprint) {
+            change.members.push_back(MemberChange{MemberChange::CHANGED, it->second, &member});
+        }
+        old_members.erase(it);
+    }
+    for (MemberSummary const& member : old_class.members) {
+        if (old_members.count(member.key())) change.members.push_back(MemberChange{MemberChange::REMOVED, &member, nullptr});
+    }
+    return change;
+}
+
+}
+
+CorpusDiff diff_corpora(Corpus const& old_corpus, Corpus const& new_corpus) {
+    CorpusDiff diff;
+    diff.old_classes = summarize_corpus(old_corpus);
+    diff.new_classes = summarize_corpus(new_corpus);
+
+    std::unordered_map<std::string, ClassSummary const*> old_classes = detail::classes_by_name(diff.old_classes);
+    std::unordered_map<std::string, ClassSummary const*> new_classes = detail::classes_by_name(diff.new_classes);
+
+    for (ClassSummary const& new_class : diff.new_classes) {
+        if (new_classes.at(new_class.name) != &new_class) continue; // Shadowed
+        auto it = old_classes.find(new_class.name);
+        if (it == old_classes.end()) {
+            diff.changes.push_back(ClassChange{ClassChange::ADDED, nullptr, &new_class, {}});
+            continue;
+        }
+        ClassChange change = detail::compare_classes(*it->second, new_class);
+        if (change.members.empty() && it->second->declaration == new_class.declaration) {
+            ++diff.unchanged_classes;
+        } else {
+            diff.changes.push_back(std::move(change));
+        }
+    }
+    for (ClassSummary const& old_class : diff.old_classes) {
+        if (old_classes.at(old_class.name) == &old_class && !new_classes.count(old_class.name)) {
+            diff.changes.push_back(ClassChange{ClassChange::REMOVED, &old_class, nullptr, {}});
+        }
+    }
+    return diff;
+}
+
+/* Output
+ *
+ *     + class <added class>
+ *     - class <removed class>
+ *     ~ <declaration of a changed class>
+ *       - <removed member>
+ *       + <added member, decompiled>
+ *       ~ <changed member, decompiled>
+ */
+
+namespace detail {
+
+std::string member_declaration(MemberSummary const& member) {
+    return intern_type(member.descriptor)->to_string(member.name);
+}
+
+std::string render_class_change(Corpus const& new_corpus, ClassChange const& change, SymbolIndex const* symbols) {
+    std::ostringstream output;
+    switch (change.kind) {
+    case ClassChange::ADDED:
+        output << "+ class " << change.new_class->name << std::endl;
+        return output.str();
+    case ClassChange::REMOVED:
+        output << "- class " << change.old_class->name << std::endl;
+        return output.str();
+    case ClassChange::CHANGED:
+        break;
+    }
+
+    output << "~ " << change.new_class->declaration << std::endl;
+    if (change.old_class->declaration != change.new_class->declaration) {
+        output << "  (was: " << change.old_class->declaration << ")" << std::endl;
+    }
+    if (change.members.empty()) return output.str();
+
+    Class class_ = read_class(new_corpus.read(change.new_class->entry));
+    for (MemberChange const& member : change.members) {
+        if (member.kind == MemberChange::REMOVED) {
+            output << "  - " << member_declaration(*member.old_member) << std::endl;
+            continue;
+        }
+        MemberSummary const& summary = *member.new_member;
+        output << (member.kind == MemberChange::ADDED ? "  + " : "  ~ ") << member_declaration(summary) << std::endl;
+        if (summary.is_method) {
+            write_method(output, class_, class_.methods[summary.index], symbols);
+        } else {
+            write_field(output, class_, class_.fields[summary.index]);
+        }
+    }
+    return output.str();
+}
+
+}
+
+void write_diff(std::ostream & output, Corpus const& new_corpus, CorpusDiff const& diff, SymbolIndex const* symbols = nullptr) {
+    // Changed classes are decompiled in parallel, but written in order
+    std::vector<std::string> rendered(diff.changes.size());
+    parallel_for(diff.changes.size(), [&](std::size_t index) {
+        rendered[index] = detail::render_class_change(new_corpus, diff.changes[index], symbols);
+    });
+
+    std::size_t counts[3] = {0, 0, 0};
+    std::size_t changed_members = 0;
+    for (std::size_t index = 0; index < diff.changes.size(); ++index) {
+        output << rendered[index];
+        ++counts[diff.changes[index].kind];
+        changed_members += diff.changes[index].members.size();
+    }
+    output << counts[ClassChange::ADDED] << " classes added, " << counts[ClassChange::REMOVED] << " removed, "
+           << counts[ClassChange::CHANGED] << " changed (" << changed_members << " members), "
+           << diff.unchanged_classes << " unchanged" << std::endl;
+}
+
+}
+
+#endif // JJDE_DIFF_HPP
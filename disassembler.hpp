@@ -4,6 +4,7 @@
 #include "bytes.hpp"
 #include "instructions.hpp"
 #include "objects.hpp"
+#include "stats.hpp"
 
 namespace jjde {
 
@@ -19,10 +20,31 @@ struct Bytecode {
     uint16_t local_variable_count;
     std::vector<Instruction> instructions;
     std::vector<ExceptionHandler> exception_handlers;
-    std::vector<Attribute> attributes;
+    AttributeList attributes;
 };
 
-Bytecode disassemble(std::vector<unsigned char> const& code) {
+namespace detail {
+
+template <typename Iterator>
+AttributeList read_code_attributes(Iterator iterator, Iterator end) {
+    if (end - iterator < 2) throw std::logic_error("Invalid bytecode (truncated Code attribute)");
+    uint16_t attribute_count = parse<uint16_t>(convert<2>(iterator));
+    AttributeList attributes;
+    for (uint16_t index = 0; index < attribute_count; ++index) {
+        if (end - iterator < 6) throw std::logic_error("Invalid bytecode (truncated Code attribute)");
+        uint16_t name_index = parse<uint16_t>(convert<2>(iterator));
+        uint32_t length = parse<uint32_t>(convert<4>(iterator));
+        if ((uint64_t) (end - iterator) < length) throw std::logic_error("Invalid bytecode (truncated Code attribute)");
+        attributes.push_back(Attribute{name_index, std::pmr::vector<unsigned char>(iterator, iterator + length)});
+        iterator += length;
+    }
+    return attributes;
+}
+
+}
+
+Bytecode disassemble(std::pmr::vector<unsigned char> const& code) {
+    JJDE_STATS_TIME(DISASSEMBLY);
     auto iterator = code.begin();
     uint16_t max_stack_size = parse<uint16_t>(convert<2>(iterator));
     uint16_t local_variable_count = parse<uint16_t>(convert<2>(iterator));
@@ -74,7 +96,7 @@ Bytecode disassemble(std::vector<unsigned char> const& code) {
             case Instruction::LOOKUPSWITCH: {
                 // LOOKUPSWITCH [padding] [arguments]
                 // Skip padding - do not add it to the argument list. If necessary, the amount of padding can be deduced from the instruction locations
-                padding = (4 - (index % 4)) % 4; // 0, 1, 2 or 3 bytes so that the next byte's location is a multiple of four.
+                padding = 3 - (index % 4); // 0, 1, 2 or 3 bytes so that the next byte's location is a multiple of four.
                 iterator += padding;
                 index += padding;
                 // Padding is followed by the default offset, a four-byte value which can be added directly to the arguments
@@ -128,19 +150,22 @@ Bytecode disassemble(std::vector<unsigned char> const& code) {
         exception_handlers.push_back(ExceptionHandler{start, end, handler, exception});
     }
     // Attributes
-    uint16_t attribute_count = parse<uint16_t>(convert<2>(iterator));
-    std::vector<Attribute> attributes;
-    for (uint16_t index = 0; index < attribute_count; ++index) {
-        uint16_t name_index = parse<uint16_t>(convert<2>(iterator));
-        uint32_t length = parse<uint32_t>(convert<4>(iterator));
-        std::vector<unsigned char> data;
-        for (uint32_t attribute_byte = 0; attribute_byte < length; ++attribute_byte) {
-            data.push_back(*iterator++);
-        }
-        attributes.push_back(Attribute{name_index, data});
-    }
+    AttributeList attributes = detail::read_code_attributes(iterator, code.end());
+
+    JJDE_STATS_COUNT(INSTRUCTIONS_DECODED, instructions.size());
+    return Bytecode { max_stack_size, local_variable_count, std::move(instructions), std::move(exception_handlers), std::move(attributes) };
+}
 
-    return Bytecode { max_stack_size, local_variable_count, instructions, exception_handlers, attributes };
+// Only the attributes of a Code attribute (such as LineNumberTable and LocalVariableTable), without
+// disassembling the code
+AttributeList code_attributes(std::pmr::vector<unsigned char> const& code) {
+    if (code.size() < 8) throw std::logic_error("Invalid bytecode (truncated Code attribute)");
+    std::size_t code_length = parse<uint32_t>(convert<4>(code, 4));
+    std::size_t handlers = 8 + code_length;
+    if (code.size() < handlers + 2) throw std::logic_error("Invalid bytecode (truncated Code attribute)");
+    std::size_t handler_count = parse<uint16_t>(convert<2>(code, handlers));
+    if (code.size() < handlers + 2 + 8 * handler_count) throw std::logic_error("Invalid bytecode (truncated Code attribute)");
+    return detail::read_code_attributes(code.begin() + handlers + 2 + 8 * handler_count, code.end());
 }
 
 }
@@ -0,0 +1,378 @@
+#ifndef JJDE_EMIT_HPP
+#define JJDE_EMIT_HPP
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "analysis.hpp"
+#include "class.hpp"
+#include "debug.hpp"
+#include "disassembler.hpp"
+#include "fingerprint.hpp"
+#include "instructions.hpp"
+#include "passes.hpp"
+#include "stats.hpp"
+
+namespace jjde {
+
+/* Machine-readable output
+ *
+ * A class is written as a flat sequence of records, each of which belongs to the closest preceding
+ * record of its parent kind:
+ *
+ *     class        source, name, parent, flags, major, minor, interfaces
+ *     field        index, name, descriptor, signature, flags
+ *     method       index, name, descriptor, signature, flags, max_stack, max_locals
+ *     instruction  offset, opcode, mnemonic, operands, resolved, target, line (of a method)
+ *     handler      start, end, handler, exception                            (of a method)
+ *     block        id, start, end, instructions                              (of a method)
+ *     edge         from, to, kind                                            (of a method)
+ *     error        message
+ *
+ * Every record has all of its fields, in this order. Strings that do not apply are empty, and target
+ * (the absolute offset of a jump) is -1 for instructions that do not jump, and line (the source line
+ * from the LineNumberTable) is -1 if unknown. resolved is the constant
+ * referenced by the instruction, if any. Blocks and edges are missing for methods whose code flow
+ * cannot be analyzed; an error record says why.
+ *
+ * Two formats are available:
+ *
+ *     JSON Lines  one object per line, with a "type" member for the record kind
+ *     Binary      u32 (little endian) payload size, then the payload: u8 record kind (RecordWriter::Kind),
+ *                 then the fields without names. Integers are LEB128 varints (signed ones zigzag
+ *                 encoded), strings and byte arrays have a varint length, lists a varint count.
+ *                 A stream starts with BinaryWriter::magic.
+ *
+ * Records are appended to a string buffer as they are produced, without building any intermediate
+ * representation.
+ */
+
+class RecordWriter {
+public:
+    enum Kind : uint8_t { CLASS = 1, FIELD, METHOD, INSTRUCTION, HANDLER, BLOCK, EDGE, ERROR };
+
+    explicit RecordWriter(std::string & buffer_) : buffer(buffer_) {}
+    virtual ~RecordWriter() {}
+
+    virtual void begin(Kind kind) = 0;
+    virtual void string_field(char const* name, std::string_view value) = 0;
+    virtual void unsigned_field(char const* name, uint64_t value) = 0;
+    virtual void signed_field(char const* name, int64_t value) = 0;
+    virtual void bytes_field(char const* name, std::vector<unsigned char> const& value) = 0;
+    virtual void list_field(char const* name, std::vector<std::string> const& values) = 0;
+    virtual void end() = 0;
+
+protected:
+    std::string & buffer;
+};
+
+class JsonLinesWriter : public RecordWriter {
+public:
+    using RecordWriter::RecordWriter;
+
+    void begin(Kind kind) override {
+        static char const* const names[] = {"", "class", "field", "method", "instruction", "handler", "block", "edge", "error"};
+        buffer += "{\"type\":\"";
+        buffer += names[kind];
+        buffer += '"';
+    }
+
+    void string_field(char const* name, std::string_view value) override {
+        key(name);
+        string(value);
+    }
+
+    void unsigned_field(char const* name, uint64_t value) override {
+        key(name);
+        number(value);
+    }
+
+    void signed_field(char const* name, int64_t value) override {
+        key(name);
+        number(value);
+    }
+
+    // Hex string
+    void bytes_field(char const* name, std::vector<unsigned char> const& value) override {
+        static char const digits[] = "0123456789ABCDEF";
+        key(name);
+        buffer += '"';
+        for (unsigned char byte : value) {
+            buffer += digits[byte >> 4];
+            buffer += digits[byte & 0xF];
+        }
+        buffer += '"';
+    }
+
+    void list_field(char const* name, std::vector<std::string> const& values) override {
+        key(name);
+        buffer += '[';
+        for (std::size_t index = 0; index < values.size(); ++index) {
+            if (index > 0) buffer += ',';
+            string(values[index]);
+        }
+        buffer += ']';
+    }
+
+    void end() override {
+        buffer += "}\n";
+    }
+
+private:
+    void key(char const* name) {
+        buffer += ",\"";
+        buffer += name;
+        buffer += "\":";
+    }
+
+    template <typename Integer>
+    void number(Integer value) {
+        char digits[24];
+        buffer.append(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr);
+    }
+
+    // Strings are passed through as UTF-8, only quotes, backslashes and control characters are escaped
+    void string(std::string_view value) {
+        static char const digits[] = "0123456789abcdef";
+        buffer += '"';
+        std::size_t plain = 0;
+        for (std::size_t index = 0; index < value.size(); ++index) {
+            unsigned char c = (unsigned char) value[index];
+            if (c >= 0x20 && c != '"' && c != '\\') continue;
+            buffer.append(value.data() + plain, index - plain);
+            plain = index + 1;
+            switch (c) {
+            case '"': buffer += "\\\""; break;
+            case '\\': buffer += "\\\\"; break;
+            case '\n': buffer += "\\n"; break;
+            case '\r': buffer += "\\r"; break;
+            case '\t': buffer += "\\t"; break;
+            default:
+                buffer += "\\u00";
+                buffer += digits[c >> 4];
+                buffer += digits[c & 0xF];
+            }
+        }
+        buffer.append(value.data() + plain, value.size() - plain);
+        buffer += '"';
+    }
+};
+
+class BinaryWriter : public RecordWriter {
+public:
+    static constexpr char const* magic = "JJDEREC1";
+
+    using RecordWriter::RecordWriter;
+
+    void begin(Kind kind) override {
+        start = buffer.size();
+        buffer.append(4, '\0'); // Size, filled in by end()
+        buffer += (char) kind;
+    }
+
+    void string_field(char const*, std::string_view value) override {
+        varint(value.size());
+        buffer.append(value.data(), value.size());
+    }
+
+    void unsigned_field(char const*, uint64_t value) override {
+        varint(value);
+    }
+
+    void signed_field(char const*, int64_t value) override {
+        varint(((uint64_t) value << 1) ^ (uint64_t) (value >> 63));
+    }
+
+    void bytes_field(char const*, std::vector<unsigned char> const& value) override {
+        varint(value.size());
+        buffer.append(reinterpret_cast<char const*>(value.data()), value.size());
+    }
+
+    void list_field(char const* name, std::vector<std::string> const& values) override {
+        varint(values.size());
+        for (std::string const& value : values) string_field(name, value);
+    }
+
+    void end() override {
+        uint32_t size = (uint32_t) (buffer.size() - start - 4);
+        for (std::size_t byte = 0; byte < 4; ++byte) {
+            buffer[start + byte] = (char) ((size >> (8 * byte)) & 0xFF);
+        }
+    }
+
+private:
+    std::size_t start = 0;
+
+    void varint(uint64_t value) {
+        while (value >= 0x80) {
+            buffer += (char) ((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        buffer += (char) value;
+    }
+};
+
+// "jsonl" or "binary"; nullptr for unknown formats
+std::unique_ptr<RecordWriter> make_record_writer(std::string const& format, std::string & buffer) {
+    if (format == "jsonl") return std::unique_ptr<RecordWriter>(new JsonLinesWriter(buffer));
+    if (format == "binary") return std::unique_ptr<RecordWriter>(new BinaryWriter(buffer));
+    return nullptr;
+}
+
+void emit_error(RecordWriter & writer, std::string_view message) {
+    writer.begin(RecordWriter::ERROR);
+    writer.string_field("message", message);
+    writer.end();
+}
+
+namespace detail {
+
+// Absolute target of a jump instruction, or -1
+inline int64_t jump_target(Instruction const& instruction) {
+    switch (instruction.operation) {
+    case Instruction::IFEQ:
+    case Instruction::IFNE:
+    case Instruction::IFLT:
+    case Instruction::IFGE:
+    case Instruction::IFGT:
+    case Instruction::IFLE:
+    case Instruction::IF_ICMPEQ:
+    case Instruction::IF_ICMPNE:
+    case Instruction::IF_ICMPLT:
+    case Instruction::IF_ICMPGE:
+    case Instruction::IF_ICMPGT:
+    case Instruction::IF_ICMPLE:
+    case Instruction::IF_ACMPEQ:
+    case Instruction::IF_ACMPNE:
+    case Instruction::IFNULL:
+    case Instruction::IFNONNULL:
+    case Instruction::GOTO:
+    case Instruction::JSR:
+        return (int64_t) instruction.location + parse<int16_t>(convert<2>(instruction.arguments));
+    case Instruction::GOTO_W:
+    case Instruction::JSR_W:
+        return (int64_t) instruction.location + parse<int32_t>(convert<4>(instruction.arguments));
+    default:
+        return -1;
+    }
+}
+
+std::string signature_of(Class const& class_, Object const& object) {
+    Attribute const* signature = object.attribute(Attribute::SIGNATURE);
+    return signature ? class_.constants.at(parse<uint16_t>(convert<2>(signature->data))).value.string : "";
+}
+
+void emit_member(RecordWriter & writer, Class const& class_, Object const& object, std::size_t index) {
+    writer.unsigned_field("index", index);
+    writer.string_field("name", class_.constants.at(object.name_index).value.string);
+    writer.string_field("descriptor", class_.constants.at(object.descriptor_index).value.string);
+    writer.string_field("signature", signature_of(class_, object));
+    writer.unsigned_field("flags", object.flags.raw);
+}
+
+void emit_code(RecordWriter & writer, MethodAnalyses & analyses) {
+    Class const& class_ = analyses.class_;
+    Bytecode const& bytecode = analyses.get<passes::Disassembly>();
+    DebugInfo const& debug = analyses.get<passes::Debugging>();
+    for (Instruction const& instruction : bytecode.instructions) {
+        writer.begin(RecordWriter::INSTRUCTION);
+        writer.unsigned_field("offset", instruction.location);
+        writer.unsigned_field("opcode", instruction.operation);
+        writer.string_field("mnemonic", Instruction::name[instruction.operation]);
+        writer.bytes_field("operands", instruction.arguments);
+        std::size_t index_size = pool_index_size(instruction.operation);
+        if (index_size > 0) {
+            uint16_t index = index_size == 1 ? instruction.arguments.at(0) : parse<uint16_t>(convert<2>(instruction.arguments));
+            writer.string_field("resolved", class_.constant(index));
+        } else {
+            writer.string_field("resolved", "");
+        }
+        writer.signed_field("target", jump_target(instruction));
+        std::optional<uint16_t> line = debug.line(instruction.location);
+        writer.signed_field("line", line ? (int64_t) *line : -1);
+        writer.end();
+    }
+
+    for (ExceptionHandler const& handler : bytecode.exception_handlers) {
+        writer.begin(RecordWriter::HANDLER);
+        writer.unsigned_field("start", handler.start);
+        writer.unsigned_field("end", handler.end);
+        writer.unsigned_field("handler", handler.handler);
+        writer.string_field("exception", handler.exception == 0 ? "" : class_.constant(handler.exception));
+        writer.end();
+    }
+
+    try {
+        CodeFlow const& flow = analyses.get<passes::Flow>();
+        for (std::size_t index = 0; index < flow.items.size(); ++index) {
+            CodeFlowItem const& item = *flow.items[index];
+            if (item.deleted) continue;
+            writer.begin(RecordWriter::BLOCK);
+            writer.unsigned_field("id", index);
+            writer.unsigned_field("start", item.instructions.front()->location);
+            writer.unsigned_field("end", item.instructions.back()->location);
+            writer.unsigned_field("instructions", item.instructions.size());
+            writer.end();
+        }
+        static char const* const kinds[] = {"flow", "back", "exception"};
+        for (CodeFlowEdge const& edge : analyses.get<passes::FlowEdges>()) {
+            writer.begin(RecordWriter::EDGE);
+            writer.unsigned_field("from", edge.from);
+            writer.unsigned_field("to", edge.to);
+            writer.string_field("kind", kinds[edge.kind]);
+            writer.end();
+        }
+    } catch (std::exception const& error) {
+        emit_error(writer, error.what());
+    }
+}
+
+}
+
+// Nothing is written if the filter rejects the class; rejected members are left out
+void emit_class(RecordWriter & writer, Class const& class_, std::string_view source, FlagFilter const& filter = FlagFilter()) {
+    if (!filter.accepts(class_.flags)) return;
+    writer.begin(RecordWriter::CLASS);
+    writer.string_field("source", source);
+    writer.string_field("name", class_.name);
+    writer.string_field("parent", class_.parent);
+    writer.unsigned_field("flags", class_.flags.raw);
+    writer.unsigned_field("major", class_.version.major);
+    writer.unsigned_field("minor", class_.version.minor);
+    writer.list_field("interfaces", class_.interfaces);
+    writer.end();
+
+    for (std::size_t index = 0; index < class_.fields.size(); ++index) {
+        if (!filter.accepts(class_.fields[index].flags)) continue;
+        writer.begin(RecordWriter::FIELD);
+        detail::emit_member(writer, class_, class_.fields[index], index);
+        writer.end();
+    }
+
+    for (std::size_t index = 0; index < class_.methods.size(); ++index) {
+        Object const& method = class_.methods[index];
+        if (!filter.accepts(method.flags)) continue;
+        JJDE_STATS_TIME_METHOD(qualified_method_name(class_, method));
+        MethodAnalyses analyses(class_, method);
+        Bytecode const* bytecode = analyses.code ? &analyses.get<passes::Disassembly>() : nullptr;
+
+        writer.begin(RecordWriter::METHOD);
+        detail::emit_member(writer, class_, method, index);
+        writer.unsigned_field("max_stack", bytecode ? bytecode->max_stack_size : 0);
+        writer.unsigned_field("max_locals", bytecode ? bytecode->local_variable_count : 0);
+        writer.end();
+
+        if (bytecode) detail::emit_code(writer, analyses);
+    }
+}
+
+}
+
+#endif // JJDE_EMIT_HPP
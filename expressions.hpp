@@ -0,0 +1,274 @@
+#ifndef JJDE_EXPRESSIONS_HPP
+#define JJDE_EXPRESSIONS_HPP
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "stack.hpp"
+
+namespace jjde {
+
+/* Expressions
+ *
+ * Expression nodes are immutable and owned by an ExpressionPool. Expressions without side effects
+ * (constants, locals, field and array reads, arithmetic) are hash-consed: building a node that is
+ * structurally identical to an existing one returns the existing node. Since the operands of a node are
+ * hash-consed as well, two such expressions have equal pointers if and only if they are structurally
+ * identical.
+ *
+ * Reads of locals, fields and array elements are also keyed by a store generation, which the pool
+ * advances whenever the value read might have changed (see store_local and store_memory). Two reads
+ * therefore only share a node if nothing was stored in between, and equal pointers imply equal values.
+ */
+
+struct Expression {
+    enum Kind : uint8_t {
+        LITERAL,       // Rendered verbatim (null, strings, classes, float and double constants)
+        INTEGER,       // int constant (folded)
+        LONG,          // long constant (folded)
+        LOCAL,         // Local variable
+        FIELD,         // Field read (operands[0] is the object, or nullptr for static fields)
+        ARRAY_LENGTH,  // operands[0].length
+        ARRAY_ELEMENT, // operands[0][operands[1]]
+        UNARY,         // (text operands[0])
+        BINARY,        // (operands[0] text operands[1])
+        OPAQUE         // Values with side effects, never shared
+    };
+
+    Kind kind;
+    std::string text;
+    int64_t value = 0; // INTEGER, LONG and LOCAL
+    uint32_t generation = 0; // LOCAL, FIELD and ARRAY_ELEMENT: store generation of the read
+    Expression const* operands[2] = { nullptr, nullptr };
+    std::size_t hash = 0;
+
+    bool is_constant() const {
+        return kind == INTEGER || kind == LONG;
+    }
+
+    std::string to_string() const {
+        switch (kind) {
+        case INTEGER:       return std::to_string(value);
+        case LONG:          return std::to_string(value) + "L";
+        case LOCAL:         return "var" + std::to_string(value);
+        case FIELD:         return operands[0] ? operands[0]->to_string() + "." + text : text;
+        case ARRAY_LENGTH:  return operands[0]->to_string() + ".length";
+        case ARRAY_ELEMENT: return operands[0]->to_string() + "[" + operands[1]->to_string() + "]";
+        case UNARY:         return "(" + text + operands[0]->to_string() + ")";
+        case BINARY:        return "(" + operands[0]->to_string() + " " + text + " " + operands[1]->to_string() + ")";
+        case LITERAL:
+        case OPAQUE:
+        default:            return text;
+        }
+    }
+};
+
+namespace detail {
+
+struct ExpressionHash {
+    std::size_t operator()(Expression const* expression) const {
+        return expression->hash;
+    }
+};
+
+struct ExpressionEqual {
+    bool operator()(Expression const* a, Expression const* b) const {
+        // Operands are hash-consed, so comparing their addresses is sufficient.
+        return a->kind == b->kind
+            && a->value == b->value
+            && a->generation == b->generation
+            && a->operands[0] == b->operands[0]
+            && a->operands[1] == b->operands[1]
+            && a->text == b->text;
+    }
+};
+
+// Java integer arithmetic (two's complement wrap-around, masked shift distances). Returns false if the
+// operation cannot be folded (unknown operator or division by zero, which throws at runtime).
+template <typename T, typename U>
+bool fold_integral(std::string const& op, T lhs, T rhs, T & result) {
+    const unsigned int mask = sizeof(T) * 8 - 1;
+    const U ulhs = (U) lhs, urhs = (U) rhs;
+    if (op == "+") result = (T) (ulhs + urhs);
+    else if (op == "-") result = (T) (ulhs - urhs);
+    else if (op == "*") result = (T) (ulhs * urhs);
+    else if (op == "/" || op == "%") {
+        if (rhs == 0) return false;
+        if (lhs == std::numeric_limits<T>::min() && rhs == -1) result = (op == "/") ? lhs : 0;
+        else result = (op == "/") ? lhs / rhs : lhs % rhs;
+    }
+    else if (op == "<<") result = (T) (ulhs << (urhs & mask));
+    else if (op == ">>") result = (lhs < 0) ? (T) ~(~ulhs >> (urhs & mask)) : (T) (ulhs >> (urhs & mask));
+    else if (op == ">>>") result = (T) (ulhs >> (urhs & mask));
+    else if (op == "&") result = lhs & rhs;
+    else if (op == "|") result = lhs | rhs;
+    else if (op == "^") result = lhs ^ rhs;
+    else return false;
+    return true;
+}
+
+}
+
+class ExpressionPool {
+public:
+    ExpressionPool() = default;
+    ExpressionPool(ExpressionPool const&) = delete;
+    ExpressionPool & operator=(ExpressionPool const&) = delete;
+
+    Expression const* literal(std::string const& text) {
+        Expression expression{Expression::LITERAL, text};
+        return intern(std::move(expression));
+    }
+
+    Expression const* integer(int32_t value) {
+        Expression expression{Expression::INTEGER, ""};
+        expression.value = value;
+        return intern(std::move(expression));
+    }
+
+    Expression const* long_(int64_t value) {
+        Expression expression{Expression::LONG, ""};
+        expression.value = value;
+        return intern(std::move(expression));
+    }
+
+    Expression const* local(uint16_t index) {
+        Expression expression{Expression::LOCAL, ""};
+        expression.value = index;
+        expression.generation = index < local_generations.size() ? local_generations[index] : 0;
+        return intern(std::move(expression));
+    }
+
+    // object is nullptr for static fields (name is then expected to be qualified)
+    Expression const* field(Expression const* object, std::string const& name) {
+        Expression expression{Expression::FIELD, name};
+        expression.operands[0] = object;
+        expression.generation = memory_generation;
+        return intern(std::move(expression));
+    }
+
+    // The length of an array never changes, so it is not keyed by a store generation
+    Expression const* array_length(Expression const* array) {
+        Expression expression{Expression::ARRAY_LENGTH, ""};
+        expression.operands[0] = array;
+        return intern(std::move(expression));
+    }
+
+    Expression const* array_element(Expression const* array, Expression const* index) {
+        Expression expression{Expression::ARRAY_ELEMENT, ""};
+        expression.operands[0] = array;
+        expression.operands[1] = index;
+        expression.generation = memory_generation;
+        return intern(std::move(expression));
+    }
+
+    // Only "-" (negation) is folded.
+    Expression const* unary(std::string const& op, Expression const* operand, StackSlot::Kind kind) {
+        if (op == "-" && operand->is_constant()) {
+            if (kind == StackSlot::INTEGER) {
+                ++folded_count;
+                return integer((int32_t) (0u - (uint32_t) operand->value));
+            }
+            if (kind == StackSlot::LONG) {
+                ++folded_count;
+                return long_((int64_t) (0ull - (uint64_t) operand->value));
+            }
+        }
+        Expression expression{Expression::UNARY, op};
+        expression.operands[0] = operand;
+        return intern(std::move(expression));
+    }
+
+    // int and long arithmetic on constants is folded. float and double arithmetic is not, since the
+    // result could not be rendered exactly.
+    Expression const* binary(std::string const& op, Expression const* lhs, Expression const* rhs, StackSlot::Kind kind) {
+        if (lhs->is_constant() && rhs->is_constant()) {
+            if (kind == StackSlot::INTEGER) {
+                int32_t result;
+                if (detail::fold_integral<int32_t, uint32_t>(op, (int32_t) lhs->value, (int32_t) rhs->value, result)) {
+                    ++folded_count;
+                    return integer(result);
+                }
+            } else if (kind == StackSlot::LONG) {
+                int64_t result;
+                // Shift distances of long shifts are ints
+                if (detail::fold_integral<int64_t, uint64_t>(op, lhs->value, rhs->value, result)) {
+                    ++folded_count;
+                    return long_(result);
+                }
+            }
+        }
+        Expression expression{Expression::BINARY, op};
+        expression.operands[0] = lhs;
+        expression.operands[1] = rhs;
+        return intern(std::move(expression));
+    }
+
+    // Values with side effects (method calls, object creation, ...) are never shared.
+    Expression const* opaque(std::string const& text) {
+        nodes.push_back(Expression{Expression::OPAQUE, text});
+        return &nodes.back();
+    }
+
+    // A value was stored into the local, so later reads of it are new expressions
+    void store_local(uint16_t index) {
+        if (index >= local_generations.size()) local_generations.resize(index + 1, 0);
+        ++local_generations[index];
+    }
+
+    // Fields or array elements might have been written (field and array stores, method calls, ...), so
+    // later reads of any of them are new expressions
+    void store_memory() {
+        ++memory_generation;
+    }
+
+    // Release all expressions (invalidates all handed out pointers)
+    void clear() {
+        table.clear();
+        nodes.clear();
+        local_generations.clear();
+        memory_generation = 0;
+        shared_count = 0;
+        folded_count = 0;
+    }
+
+    std::size_t size() const { return nodes.size(); }
+    std::size_t shared() const { return shared_count; }
+    std::size_t folded() const { return folded_count; }
+
+private:
+    std::deque<Expression> nodes; // Stable addresses
+    std::unordered_set<Expression const*, detail::ExpressionHash, detail::ExpressionEqual> table;
+    std::vector<uint32_t> local_generations; // Per local variable index
+    uint32_t memory_generation = 0;
+    std::size_t shared_count = 0;
+    std::size_t folded_count = 0;
+
+    Expression const* intern(Expression && expression) {
+        std::size_t hash = std::hash<std::string>()(expression.text);
+        hash = hash * 31 + expression.kind;
+        hash = hash * 31 + std::hash<int64_t>()(expression.value);
+        hash = hash * 31 + expression.generation;
+        hash = hash * 31 + std::hash<Expression const*>()(expression.operands[0]);
+        hash = hash * 31 + std::hash<Expression const*>()(expression.operands[1]);
+        expression.hash = hash;
+
+        auto it = table.find(&expression);
+        if (it != table.end()) {
+            ++shared_count;
+            return *it;
+        }
+        nodes.push_back(std::move(expression));
+        table.insert(&nodes.back());
+        return &nodes.back();
+    }
+};
+
+}
+
+#endif // JJDE_EXPRESSIONS_HPP
@@ -0,0 +1,132 @@
+#ifndef JJDE_FINGERPRINT_HPP
+#define JJDE_FINGERPRINT_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "class.hpp"
+#include "disassembler.hpp"
+#include "hash.hpp"
+#include "instructions.hpp"
+
+namespace jjde {
+
+/* Method fingerprints
+ *
+ * A fingerprint is a hash of a method's flags, descriptor and code in which every constant pool index
+ * is replaced by a hash of the constant it refers to. Two compilations of the same method therefore
+ * have the same fingerprint even if the constant pools were laid out differently, for example because
+ * some other method of the class changed.
+ */
+
+namespace detail {
+
+// Hash of the contents of a constant (references are followed recursively)
+uint64_t hash_constant(std::vector<Constant> const& pool, uint16_t index, unsigned depth = 0) {
+    if (index >= pool.size() || depth > 8) return hash_combine(0, 0xFFFF); // Invalid (or cyclic) reference
+    Constant const& constant = pool[index];
+    uint64_t hash = hash_combine(0, constant.type);
+    uint64_t bits = 0;
+    switch (constant.type) {
+    case Constant::STRING:
+        return hash_combine(hash, hash_bytes(constant.value.string));
+    case Constant::INTEGER:
+        return hash_combine(hash, (uint32_t) constant.value.integer);
+    case Constant::FLOAT:
+        std::memcpy(&bits, &constant.value.float_, sizeof(float));
+        return hash_combine(hash, bits);
+    case Constant::LONG:
+        return hash_combine(hash, (uint64_t) constant.value.long_);
+    case Constant::DOUBLE:
+        std::memcpy(&bits, &constant.value.double_, sizeof(double));
+        return hash_combine(hash, bits);
+    case Constant::CLASS_REFERENCE:
+    case Constant::STRING_REFERENCE:
+    case Constant::METHOD_TYPE:
+        return hash_combine(hash, hash_constant(pool, constant.value.reference, depth + 1));
+    case Constant::FIELD_REFERENCE:
+    case Constant::METHOD_REFERENCE:
+    case Constant::INTERFACE_METHOD_REFERENCE:
+    case Constant::NAME_TYPE_DESCRIPTOR:
+        hash = hash_combine(hash, hash_constant(pool, constant.value.pair_reference.first, depth + 1));
+        return hash_combine(hash, hash_constant(pool, constant.value.pair_reference.second, depth + 1));
+    case Constant::METHOD_HANDLE:
+        hash = hash_combine(hash, constant.value.method_handle.first);
+        return hash_combine(hash, hash_constant(pool, constant.value.method_handle.second, depth + 1));
+    case Constant::INVOKE_DYNAMIC:
+        // u2 bootstrap method (index into the BootstrapMethods attribute), u2 name and type
+        hash = hash_combine(hash, constant.value.invoke_dynamic >> 16);
+        return hash_combine(hash, hash_constant(pool, (uint16_t) (constant.value.invoke_dynamic & 0xFFFF), depth + 1));
+    default:
+        return hash;
+    }
+}
+
+// Number of leading operand bytes that form a constant pool index
+inline std::size_t pool_index_size(Instruction::Operation operation) {
+    switch (operation) {
+    case Instruction::LDC:
+        return 1;
+    case Instruction::LDC_W:
+    case Instruction::LDC2_W:
+    case Instruction::GETSTATIC:
+    case Instruction::PUTSTATIC:
+    case Instruction::GETFIELD:
+    case Instruction::PUTFIELD:
+    case Instruction::INVOKEVIRTUAL:
+    case Instruction::INVOKESPECIAL:
+    case Instruction::INVOKESTATIC:
+    case Instruction::INVOKEINTERFACE:
+    case Instruction::INVOKEDYMANIC:
+    case Instruction::NEW:
+    case Instruction::ANEWARRAY:
+    case Instruction::CHECKCAST:
+    case Instruction::INSTANCEOF:
+    case Instruction::MULTIANEWARRAY:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+}
+
+uint64_t fingerprint_code(Class const& class_, Bytecode const& bytecode) {
+    uint64_t hash = hash_combine(hash_combine(0, bytecode.max_stack_size), bytecode.local_variable_count);
+    for (Instruction const& instruction : bytecode.instructions) {
+        hash = hash_combine(hash, instruction.operation);
+        // Branch offsets are relative, and all other operands are independent of the constant pool
+        std::size_t skip = detail::pool_index_size(instruction.operation);
+        if (skip == 1) {
+            hash = hash_combine(hash, detail::hash_constant(class_.constants, instruction.arguments.at(0)));
+        } else if (skip == 2) {
+            hash = hash_combine(hash, detail::hash_constant(class_.constants, parse<uint16_t>(convert<2>(instruction.arguments))));
+        }
+        hash = hash_combine(hash, hash_bytes(instruction.arguments.data() + skip, instruction.arguments.size() - skip));
+    }
+    for (ExceptionHandler const& handler : bytecode.exception_handlers) {
+        hash = hash_combine(hash, ((uint64_t) handler.start << 32) | ((uint64_t) handler.end << 16) | handler.handler);
+        hash = hash_combine(hash, handler.exception == 0 ? 0 : detail::hash_constant(class_.constants, handler.exception));
+    }
+    return hash;
+}
+
+// Fingerprint of a method (or field), including its flags and descriptor
+uint64_t fingerprint_method(Class const& class_, Object const& method) {
+    uint64_t hash = hash_combine(hash_combine(0, method.flags.raw), detail::hash_constant(class_.constants, method.descriptor_index));
+    for (Attribute const& attribute : method.attributes) {
+        Attribute::Kind kind = attribute_kind(class_.attribute_kinds, attribute);
+        if (kind == Attribute::CODE) {
+            hash = hash_combine(hash, fingerprint_code(class_, disassemble(attribute.data)));
+        } else if (kind == Attribute::SIGNATURE || kind == Attribute::CONSTANT_VALUE) {
+            hash = hash_combine(hash, detail::hash_constant(class_.constants, parse<uint16_t>(convert<2>(attribute.data))));
+        }
+    }
+    return hash;
+}
+
+}
+
+#endif // JJDE_FINGERPRINT_HPP
@@ -2,70 +2,138 @@
 #define JJDE_FLAGS_HPP
 
 #include <array>
+#include <cstdint>
 #include <fstream>
+#include <string>
 
 #include "bytes.hpp"
 
 namespace jjde {
 
-/* Flags */
+/* Flags
+ *
+ * The access flags of a class, field or method, exactly as stored in the class file. Some bits mean
+ * different things depending on what the flags belong to (0x0040 is ACC_VOLATILE for fields, but
+ * ACC_BRIDGE for methods), so the context is stored alongside. Tests of several flags at once are
+ * single mask tests on raw (see has_any).
+ */
 
 struct Flags {
-    bool is_class;
-
-    bool is_public;
-    bool is_private;
-    bool is_protected;
-    bool is_static;
-    bool is_final;
-    bool is_special_super; // for classes, always set except for really old code
-    bool is_synchronized; // for variables
-    bool is_volatile;
-    bool is_transient;
-    bool is_native;
-    bool is_interface;
-    bool is_abstract;
-    bool is_strictfp;
-
-    Flags(std::array<unsigned char, 2> values, bool is_class_)
-        : is_class(is_class_)
-        , is_public(values[1] & 0x01)
-        , is_private(values[1] & 0x02)
-        , is_protected(values[1] & 0x04)
-        , is_static(values[1] & 0x08)
-        , is_final(values[1] & 0x10)
-        // set both is_special_super and is_synchronized
-        , is_special_super(values[1] & 0x20)
-        , is_synchronized(values[1] & 0x20)
-        , is_volatile(values[1] & 0x40)
-        , is_transient(values[1] & 0x80)
-        , is_native(values[0] & 0x01)
-        , is_interface(values[0] & 0x02)
-        , is_abstract(values[0] & 0x04)
-        , is_strictfp(values[0] & 0x08)
-        // synthetic, ...
-    {}
-
-    std::string to_string() const {
-        std::string output;
-        if (is_public) output += "public ";
-        if (is_private) output += "private ";
-        if (is_protected) output += "protected ";
-        if (is_static) output += "static ";
-        if (is_final) output += "final ";
-        if (!is_class && is_synchronized) output += "synchronized "; // No output for special super.
-        if (is_volatile) output += "volatile ";
-        if (is_transient) output += "transient ";
-        if (is_native) output += "native ";
-        if (is_interface) output += "interface ";
-        if (is_abstract) output += "abstract ";
-        if (is_strictfp) output += "strictfp ";
-        return output.substr(0, output.size() - 1);
+    enum Context : uint8_t { CLASS, FIELD, METHOD };
+
+    enum : uint16_t {
+        PUBLIC = 0x0001,
+        PRIVATE = 0x0002,
+        PROTECTED = 0x0004,
+        STATIC = 0x0008,
+        FINAL = 0x0010,
+        SUPER = 0x0020,        // Classes
+        SYNCHRONIZED = 0x0020, // Methods
+        VOLATILE = 0x0040,     // Fields
+        BRIDGE = 0x0040,       // Methods
+        TRANSIENT = 0x0080,    // Fields
+        VARARGS = 0x0080,      // Methods
+        NATIVE = 0x0100,
+        INTERFACE = 0x0200,
+        ABSTRACT = 0x0400,
+        STRICT = 0x0800,
+        SYNTHETIC = 0x1000,
+        ANNOTATION = 0x2000,
+        ENUM = 0x4000,
+        MODULE = 0x8000,       // Classes
+        MANDATED = 0x8000      // Parameters
+    };
+
+    uint16_t raw; // All flags, as stored in the class file
+    Context context;
+
+    Flags(uint16_t raw_, Context context_)
+        : raw(raw_)
+        , context(context_) {}
+
+    Flags(std::array<unsigned char, 2> values, Context context_)
+        : Flags(parse<uint16_t>(values), context_) {}
+
+    bool has_any(uint16_t mask) const { return (raw & mask) != 0; }
+    bool has_all(uint16_t mask) const { return (raw & mask) == mask; }
+
+    bool is_public() const { return raw & PUBLIC; }
+    bool is_private() const { return raw & PRIVATE; }
+    bool is_protected() const { return raw & PROTECTED; }
+    bool is_static() const { return raw & STATIC; }
+    bool is_final() const { return raw & FINAL; }
+    bool is_synchronized() const { return context == METHOD && (raw & SYNCHRONIZED); }
+    bool is_volatile() const { return context == FIELD && (raw & VOLATILE); }
+    bool is_bridge() const { return context == METHOD && (raw & BRIDGE); }
+    bool is_transient() const { return context == FIELD && (raw & TRANSIENT); }
+    bool is_varargs() const { return context == METHOD && (raw & VARARGS); }
+    bool is_native() const { return raw & NATIVE; }
+    bool is_interface() const { return raw & INTERFACE; }
+    bool is_abstract() const { return raw & ABSTRACT; }
+    bool is_strict() const { return raw & STRICT; }
+    bool is_synthetic() const { return raw & SYNTHETIC; }
+    bool is_annotation() const { return raw & ANNOTATION; }
+    bool is_enum() const { return raw & ENUM; }
+
+    // Modifier keywords, separated by spaces (from a table that is built once per context)
+    std::string const& to_string() const {
+        static std::array<std::array<std::string, MODIFIER_COMBINATIONS>, 3> const table = build_table();
+        return table[context][raw & (MODIFIER_COMBINATIONS - 1)];
+    }
+
+private:
+    // All keywords are in the low 12 bits
+    static constexpr std::size_t MODIFIER_COMBINATIONS = 0x1000;
+
+    static std::array<std::array<std::string, MODIFIER_COMBINATIONS>, 3> build_table() {
+        struct Keyword {
+            uint16_t mask;
+            uint8_t contexts; // Bit set of Context
+            char const* name;
+        };
+        uint8_t const all = (1 << CLASS) | (1 << FIELD) | (1 << METHOD);
+        static Keyword const keywords[] = {
+            {PUBLIC, all, "public"},
+            {PRIVATE, all, "private"},
+            {PROTECTED, all, "protected"},
+            {STATIC, all, "static"},
+            {FINAL, all, "final"},
+            {SYNCHRONIZED, 1 << METHOD, "synchronized"},
+            {VOLATILE, 1 << FIELD, "volatile"},
+            {TRANSIENT, 1 << FIELD, "transient"},
+            {NATIVE, 1 << METHOD, "native"},
+            {INTERFACE, 1 << CLASS, "interface"},
+            {ABSTRACT, (1 << CLASS) | (1 << METHOD), "abstract"},
+            {STRICT, (1 << CLASS) | (1 << METHOD), "strictfp"},
+        };
+        std::array<std::array<std::string, MODIFIER_COMBINATIONS>, 3> table;
+        for (std::size_t context = 0; context < 3; ++context) {
+            for (std::size_t bits = 0; bits < MODIFIER_COMBINATIONS; ++bits) {
+                std::string & output = table[context][bits];
+                for (Keyword const& keyword : keywords) {
+                    if (!(keyword.contexts & (1 << context)) || !(bits & keyword.mask)) continue;
+                    if (!output.empty()) output += ' ';
+                    output += keyword.name;
+                }
+            }
+        }
+        return table;
+    }
+};
+
+/* Filtering classes and members: kept if all required and none of the excluded flags are set */
+
+struct FlagFilter {
+    uint16_t required = 0;
+    uint16_t excluded = 0;
+
+    bool accepts(Flags const& flags) const {
+        return (flags.raw & (required | excluded)) == required;
     }
 };
 
-Flags read_class_flags(std::ifstream & stream) {
-    return Flags(extract<2>(stream), true);
+Flags read_class_flags(std::istream & stream) {
+    return Flags(extract<2>(stream), Flags::CLASS);
 }
 
 }
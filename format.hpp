@@ -0,0 +1,144 @@
+#ifndef JJDE_FORMAT_HPP
+#define JJDE_FORMAT_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace jjde {
+
+/* Formatting into caller buffers
+ *
+ * Hex dumps and escaped string literals are written straight into a buffer supplied by the caller
+ * (a character array that is large enough, the end of a string or, in chunks, a stream), one table
+ * lookup per byte. Nothing is allocated except by growing the caller's string.
+ */
+
+namespace detail {
+
+char const hex_digits[] = "0123456789ABCDEF";
+
+// Escape sequence of each byte (printable characters other than '"' and '\\' stand for themselves)
+struct EscapeTable {
+    char text[256][4];
+    uint8_t size[256];
+};
+
+constexpr EscapeTable make_escape_table() {
+    EscapeTable table{};
+    for (int value = 0; value < 256; ++value) {
+        char special = 0;
+        switch (value) {
+        case '"':  special = '"'; break;
+        case '\\': special = '\\'; break;
+        case '\t': special = 't'; break;
+        case '\b': special = 'b'; break;
+        case '\n': special = 'n'; break;
+        case '\r': special = 'r'; break;
+        case '\f': special = 'f'; break;
+        }
+        if (special) {
+            table.text[value][0] = '\\';
+            table.text[value][1] = special;
+            table.size[value] = 2;
+        } else if (32 <= value && value <= 126) {
+            table.text[value][0] = (char) value;
+            table.size[value] = 1;
+        } else { // Three octal digits
+            table.text[value][0] = '\\';
+            table.text[value][1] = (char) ('0' + (value >> 6));
+            table.text[value][2] = (char) ('0' + ((value >> 3) & 7));
+            table.text[value][3] = (char) ('0' + (value & 7));
+            table.size[value] = 4;
+        }
+    }
+    return table;
+}
+
+constexpr EscapeTable escape_table = make_escape_table();
+
+// Length of the prefix of [data, data + size) that needs no escaping
+inline std::size_t plain_prefix(unsigned char const* data, std::size_t size) {
+    std::size_t index = 0;
+#if defined(__SSE2__)
+    // Sixteen bytes at a time: printable (signed compare, so bytes >= 0x80 fail) and neither '"' nor '\\'
+    __m128i const low = _mm_set1_epi8(31);
+    __m128i const high = _mm_set1_epi8(127);
+    __m128i const quote = _mm_set1_epi8('"');
+    __m128i const backslash = _mm_set1_epi8('\\');
+    for (; index + 16 <= size; index += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + index));
+        __m128i plain = _mm_and_si128(_mm_cmpgt_epi8(bytes, low), _mm_cmplt_epi8(bytes, high));
+        __m128i special = _mm_or_si128(_mm_cmpeq_epi8(bytes, quote), _mm_cmpeq_epi8(bytes, backslash));
+        unsigned int mask = (unsigned int) _mm_movemask_epi8(_mm_andnot_si128(special, plain));
+        if (mask != 0xFFFF) return index + __builtin_ctz(~mask);
+    }
+#endif
+    while (index < size && escape_table.size[data[index]] == 1) ++index;
+    return index;
+}
+
+}
+
+/* Hex dumps: two upper case digits and a space per byte */
+
+constexpr std::size_t hex_size(std::size_t size) {
+    return 3 * size;
+}
+
+// Writes hex_size(size) characters, returns the end of the output
+inline char * write_hex(char * output, unsigned char const* data, std::size_t size) {
+    for (std::size_t index = 0; index < size; ++index) {
+        output[0] = detail::hex_digits[data[index] >> 4];
+        output[1] = detail::hex_digits[data[index] & 15];
+        output[2] = ' ';
+        output += 3;
+    }
+    return output;
+}
+
+inline void append_hex(std::string & output, unsigned char const* data, std::size_t size) {
+    std::size_t offset = output.size();
+    output.resize(offset + hex_size(size));
+    write_hex(&output[offset], data, size);
+}
+
+// In chunks through a buffer on the stack
+inline void write_hex(std::ostream & output, unsigned char const* data, std::size_t size) {
+    constexpr std::size_t chunk = 64;
+    char buffer[hex_size(chunk)];
+    for (std::size_t offset = 0; offset < size; offset += chunk) {
+        std::size_t count = std::min(chunk, size - offset);
+        output.write(buffer, write_hex(buffer, data + offset, count) - buffer);
+    }
+}
+
+/* String literals: quoted, with Java escape sequences (octal for other unprintable bytes) */
+
+inline void append_escaped(std::string & output, char const* data, std::size_t size) {
+    unsigned char const* bytes = reinterpret_cast<unsigned char const*>(data);
+    output.reserve(output.size() + size + 2);
+    output += '"';
+    std::size_t index = 0;
+    while (index < size) {
+        std::size_t plain = detail::plain_prefix(bytes + index, size - index);
+        output.append(data + index, plain);
+        index += plain;
+        if (index < size) {
+            output.append(detail::escape_table.text[bytes[index]], detail::escape_table.size[bytes[index]]);
+            ++index;
+        }
+    }
+    output += '"';
+}
+
+}
+
+#endif // JJDE_FORMAT_HPP
@@ -0,0 +1,128 @@
+#ifndef JJDE_HASH_HPP
+#define JJDE_HASH_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace jjde {
+
+/* 64-bit hashing (XXH64)
+ *
+ * Used wherever hashes are persisted or compared across runs (indices, caches, fingerprints), so the
+ * result must not depend on the standard library implementation like std::hash does.
+ */
+
+namespace detail {
+
+constexpr uint64_t XXH_PRIME_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t XXH_PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t XXH_PRIME_3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t XXH_PRIME_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t XXH_PRIME_5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t rotate_left(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+inline uint64_t read_u64(unsigned char const* data) {
+    uint64_t value;
+    std::memcpy(&value, data, 8); // Little endian hosts only (as the reference implementation)
+    return value;
+}
+
+inline uint32_t read_u32(unsigned char const* data) {
+    uint32_t value;
+    std::memcpy(&value, data, 4);
+    return value;
+}
+
+inline uint64_t xxh_round(uint64_t accumulator, uint64_t input) {
+    accumulator += input * XXH_PRIME_2;
+    accumulator = rotate_left(accumulator, 31);
+    return accumulator * XXH_PRIME_1;
+}
+
+inline uint64_t xxh_merge(uint64_t accumulator, uint64_t value) {
+    accumulator ^= xxh_round(0, value);
+    return accumulator * XXH_PRIME_1 + XXH_PRIME_4;
+}
+
+}
+
+inline uint64_t hash_bytes(void const* input, std::size_t size, uint64_t seed = 0) {
+    using namespace detail;
+    unsigned char const* data = static_cast<unsigned char const*>(input);
+    unsigned char const* end = data + size;
+    uint64_t hash;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + XXH_PRIME_1 + XXH_PRIME_2;
+        uint64_t v2 = seed + XXH_PRIME_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - XXH_PRIME_1;
+        do {
+            v1 = xxh_round(v1, read_u64(data));
+            v2 = xxh_round(v2, read_u64(data + 8));
+            v3 = xxh_round(v3, read_u64(data + 16));
+            v4 = xxh_round(v4, read_u64(data + 24));
+            data += 32;
+        } while (data + 32 <= end);
+        hash = rotate_left(v1, 1) + rotate_left(v2, 7) + rotate_left(v3, 12) + rotate_left(v4, 18);
+        hash = xxh_merge(hash, v1);
+        hash = xxh_merge(hash, v2);
+        hash = xxh_merge(hash, v3);
+        hash = xxh_merge(hash, v4);
+    } else {
+        hash = seed + XXH_PRIME_5;
+    }
+
+    hash += (uint64_t) size;
+
+    while (data + 8 <= end) {
+        hash ^= xxh_round(0, read_u64(data));
+        hash = rotate_left(hash, 27) * XXH_PRIME_1 + XXH_PRIME_4;
+        data += 8;
+    }
+    if (data + 4 <= end) {
+        hash ^= (uint64_t) read_u32(data) * XXH_PRIME_1;
+        hash = rotate_left(hash, 23) * XXH_PRIME_2 + XXH_PRIME_3;
+        data += 4;
+    }
+    while (data < end) {
+        hash ^= (*data) * XXH_PRIME_5;
+        hash = rotate_left(hash, 11) * XXH_PRIME_1;
+        ++data;
+    }
+
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME_2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+inline uint64_t hash_bytes(std::string_view data, uint64_t seed = 0) {
+    return hash_bytes(data.data(), data.size(), seed);
+}
+
+// Combine a hash with another value (for hashing sequences of fields)
+inline uint64_t hash_combine(uint64_t hash, uint64_t value) {
+    return detail::xxh_merge(hash, value);
+}
+
+inline std::string hash_to_string(uint64_t hash) {
+    static const char digits[] = "0123456789abcdef";
+    std::string output(16, '0');
+    for (int index = 15; index >= 0; --index) {
+        output[index] = digits[hash & 0xF];
+        hash >>= 4;
+    }
+    return output;
+}
+
+}
+
+#endif // JJDE_HASH_HPP
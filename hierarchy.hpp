@@ -0,0 +1,234 @@
+#ifndef JJDE_HIERARCHY_HPP
+#define JJDE_HIERARCHY_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "class.hpp"
+#include "corpus.hpp"
+
+namespace jjde {
+
+/* Class hierarchy graph
+ *
+ * Every class in the corpus, and every class that is named as a superclass or interface without being
+ * part of the corpus ("external" classes), gets a dense integer ID. Edges are stored in compressed
+ * sparse row form: the direct supertypes of class c are supertypes[supertype_offsets[c] ...
+ * supertype_offsets[c + 1]], with the superclass (if any) first. The reverse edges (direct subtypes)
+ * are stored the same way.
+ *
+ * Only the class headers are read (in parallel), so building the graph does not parse any fields,
+ * methods or attributes.
+ */
+
+class ClassHierarchy {
+public:
+    static constexpr uint32_t NONE = 0xFFFFFFFF;
+
+    explicit ClassHierarchy(Corpus const& corpus) {
+        struct Header {
+            std::string name;
+            std::string parent;
+            std::vector<std::string> interfaces;
+            bool is_interface = false;
+        };
+        std::vector<std::pair<std::size_t, Header>> headers = read_corpus(corpus, [](std::vector<unsigned char> const& bytes, std::size_t) {
+            ClassHeader header = read_class_header(bytes);
+            return Header{std::move(header.name), std::move(header.parent), std::move(header.interfaces), header.flags.is_interface()};
+        });
+
+        // IDs: readable classes of the corpus first (only the first of several with the same name), then external classes
+        std::vector<Header const*> owners;
+        for (std::pair<std::size_t, Header> const& entry : headers) {
+            Header const& header = entry.second;
+            if (intern(header.name) == owners.size()) {
+                owners.push_back(&header);
+                flags[owners.size() - 1] |= KNOWN | (header.is_interface ? INTERFACE : 0);
+            }
+        }
+
+        // Supertype edges (external classes have none)
+        for (Header const* header : owners) {
+            uint32_t parent = header->parent.empty() ? NONE : intern(header->parent);
+            superclasses.push_back(parent);
+            if (parent != NONE) supertypes.push_back(parent);
+            for (std::string const& interface : header->interfaces) {
+                supertypes.push_back(intern(interface));
+            }
+            supertype_offsets.push_back((uint32_t) supertypes.size());
+        }
+        superclasses.resize(size(), NONE);
+        supertype_offsets.resize(size() + 1, (uint32_t) supertypes.size());
+
+        build_subtypes();
+        compute_depths();
+    }
+
+    std::size_t size() const { return names.size(); }
+
+    std::optional<uint32_t> id(std::string_view name) const {
+        auto it = ids.find(name);
+        if (it == ids.end()) return std::nullopt;
+        return it->second;
+    }
+
+    std::string const& name(uint32_t id) const { return names.at(id); }
+
+    // External classes are only known by name
+    bool is_known(uint32_t id) const { return flags.at(id) & KNOWN; }
+    bool is_interface(uint32_t id) const { return flags.at(id) & INTERFACE; }
+
+    uint32_t superclass(uint32_t id) const { return superclasses.at(id); }
+
+    // Direct supertypes (superclass first, then interfaces)
+    std::pair<uint32_t const*, uint32_t const*> supertypes_of(uint32_t id) const {
+        return {supertypes.data() + supertype_offsets.at(id), supertypes.data() + supertype_offsets.at(id + 1)};
+    }
+
+    // Direct subtypes (subclasses and subinterfaces, or implementing classes for interfaces)
+    std::pair<uint32_t const*, uint32_t const*> subtypes_of(uint32_t id) const {
+        return {subtypes.data() + subtype_offsets.at(id), subtypes.data() + subtype_offsets.at(id + 1)};
+    }
+
+    // Whether a value of type `type` can be assigned to a variable of type `super` (reflexive)
+    bool is_subtype(uint32_t type, uint32_t super) const {
+        if (type == super) return true;
+        if (is_known(super) && !is_interface(super)) {
+            // Superclass chains only need a walk up to the depth of `super`
+            if (depth.at(super) == UNKNOWN_DEPTH) return false;
+            for (uint32_t current = type; current != NONE && depth[current] != UNKNOWN_DEPTH && depth[current] >= depth[super]; current = superclasses[current]) {
+                if (current == super) return true;
+            }
+            return false;
+        }
+        // Interfaces can be reached along any path
+        std::vector<uint32_t> stack{type};
+        std::vector<bool> visited(size());
+        visited[type] = true;
+        while (!stack.empty()) {
+            uint32_t current = stack.back();
+            stack.pop_back();
+            for (uint32_t const* it = supertypes.data() + supertype_offsets[current]; it != supertypes.data() + supertype_offsets[current + 1]; ++it) {
+                if (*it == super) return true;
+                if (!visited[*it]) {
+                    visited[*it] = true;
+                    stack.push_back(*it);
+                }
+            }
+        }
+        return false;
+    }
+
+    // Most specific common superclass, as used when merging types (interfaces merge to their common
+    // superclass, java.lang.Object). NONE if the superclass chains do not meet within the graph (for
+    // example, because they end in different external classes).
+    uint32_t common_superclass(uint32_t a, uint32_t b) const {
+        if (is_interface(a) || is_interface(b)) {
+            if (a == b) return a;
+            std::optional<uint32_t> object = id("java.lang.Object");
+            return object ? *object : NONE;
+        }
+        if (depth.at(a) == UNKNOWN_DEPTH || depth.at(b) == UNKNOWN_DEPTH) return NONE;
+        while (depth[a] > depth[b]) a = superclasses[a];
+        while (depth[b] > depth[a]) b = superclasses[b];
+        while (a != b) {
+            a = superclasses[a];
+            b = superclasses[b];
+            if (a == NONE || b == NONE) return NONE;
+        }
+        return a;
+    }
+
+    // All classes (not interfaces) that are subtypes of the given type, directly or indirectly
+    std::vector<uint32_t> implementors(uint32_t type) const {
+        std::vector<uint32_t> result;
+        std::vector<uint32_t> stack{type};
+        std::vector<bool> visited(size());
+        visited[type] = true;
+        while (!stack.empty()) {
+            uint32_t current = stack.back();
+            stack.pop_back();
+            for (uint32_t const* it = subtypes.data() + subtype_offsets[current]; it != subtypes.data() + subtype_offsets[current + 1]; ++it) {
+                if (visited[*it]) continue;
+                visited[*it] = true;
+                stack.push_back(*it);
+                if (!is_interface(*it)) result.push_back(*it);
+            }
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+private:
+    enum : uint8_t { KNOWN = 1, INTERFACE = 2 };
+    static constexpr uint32_t UNKNOWN_DEPTH = 0xFFFFFFFF;
+
+    std::deque<std::string> names; // Stable addresses (ids holds views into these strings)
+    std::unordered_map<std::string_view, uint32_t> ids;
+    std::vector<uint8_t> flags;
+    std::vector<uint32_t> superclasses;
+    std::vector<uint32_t> supertype_offsets{0};
+    std::vector<uint32_t> supertypes;
+    std::vector<uint32_t> subtype_offsets;
+    std::vector<uint32_t> subtypes;
+    std::vector<uint32_t> depth; // Length of the superclass chain (UNKNOWN_DEPTH for cycles)
+
+    uint32_t intern(std::string const& name) {
+        auto it = ids.find(name);
+        if (it != ids.end()) return it->second;
+        uint32_t id = (uint32_t) names.size();
+        names.push_back(name);
+        flags.push_back(0);
+        ids.emplace(names.back(), id);
+        return id;
+    }
+
+    // Reverse the supertype edges (counting sort, so that the subtypes are ordered by ID)
+    void build_subtypes() {
+        subtype_offsets.assign(size() + 1, 0);
+        for (uint32_t super : supertypes) ++subtype_offsets[super + 1];
+        for (std::size_t id = 0; id < size(); ++id) subtype_offsets[id + 1] += subtype_offsets[id];
+        subtypes.resize(supertypes.size());
+        std::vector<uint32_t> next(subtype_offsets.begin(), subtype_offsets.end() - 1);
+        for (uint32_t id = 0; id < size(); ++id) {
+            for (uint32_t edge = supertype_offsets[id]; edge < supertype_offsets[id + 1]; ++edge) {
+                subtypes[next[supertypes[edge]]++] = id;
+            }
+        }
+    }
+
+    // External classes count as roots (depth 0); classes on superclass cycles keep UNKNOWN_DEPTH.
+    void compute_depths() {
+        depth.assign(size(), UNKNOWN_DEPTH);
+        std::vector<uint8_t> state(size(), 0); // 0: not visited, 1: on the current chain, 2: done
+        std::vector<uint32_t> chain;
+        for (uint32_t id = 0; id < size(); ++id) {
+            chain.clear();
+            uint32_t current = id;
+            while (current != NONE && state[current] == 0) {
+                state[current] = 1;
+                chain.push_back(current);
+                current = superclasses[current];
+            }
+            uint32_t next;
+            if (current == NONE) next = 0;
+            else if (state[current] == 2 && depth[current] != UNKNOWN_DEPTH) next = depth[current] + 1;
+            else next = UNKNOWN_DEPTH; // Cycle
+            for (std::size_t index = chain.size(); index-- > 0;) {
+                depth[chain[index]] = next;
+                state[chain[index]] = 2;
+                if (next != UNKNOWN_DEPTH) ++next;
+            }
+        }
+    }
+};
+
+}
+
+#endif // JJDE_HIERARCHY_HPP
@@ -0,0 +1,481 @@
+#ifndef JJDE_INDEX_HPP
+#define JJDE_INDEX_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "class.hpp"
+#include "corpus.hpp"
+#include "flags.hpp"
+#include "hash.hpp"
+
+namespace jjde {
+
+/* Cross-class symbol index
+ *
+ * The index records the name, parent, interfaces, flags and members (with descriptors, signatures and
+ * flags) of every class in a corpus. It is written once by SymbolIndexBuilder and then memory-mapped
+ * by SymbolIndex, which answers lookups through open-addressing hash tables stored in the file itself,
+ * so opening an index does not parse or copy anything.
+ *
+ * File layout (native byte order, every section aligned to 8 bytes):
+ *     IndexHeader
+ *     strings     (u4 length + bytes, referenced by offset)
+ *     classes     (IndexClass[class_count])
+ *     members     (IndexMember[member_count], grouped by class: fields, then methods)
+ *     interfaces  (u4 string offsets, grouped by class)
+ *     class table (u4[class_table_size], class index + 1, keyed by the class name)
+ *     member table (u4[member_table_size], member index + 1, keyed by owner, name and descriptor)
+ *
+ * Class names are stored in their dotted form (java.lang.Object), like Class::name.
+ */
+
+namespace detail {
+
+constexpr char INDEX_MAGIC[8] = { 'J', 'J', 'D', 'E', 'I', 'D', 'X', '\0' };
+constexpr uint32_t INDEX_VERSION = 2;
+constexpr uint32_t INDEX_NONE = 0xFFFFFFFF;
+
+struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t class_count;
+    uint32_t member_count;
+    uint32_t interface_count;
+    uint32_t class_table_size;  // Power of two
+    uint32_t member_table_size; // Power of two
+    uint64_t strings_offset;
+    uint64_t strings_size;
+    uint64_t classes_offset;
+    uint64_t members_offset;
+    uint64_t interfaces_offset;
+    uint64_t class_table_offset;
+    uint64_t member_table_offset;
+    uint64_t content_hash;      // Hash of all sections (see SymbolIndex::fingerprint)
+};
+
+struct IndexClass {
+    uint32_t name;
+    uint32_t parent; // INDEX_NONE for java.lang.Object
+    uint32_t first_interface;
+    uint32_t interface_count;
+    uint32_t first_member;
+    uint32_t field_count;
+    uint32_t method_count;
+    uint16_t flags;
+    uint16_t reserved;
+};
+
+struct IndexMember {
+    uint32_t owner; // Class index
+    uint32_t name;
+    uint32_t descriptor;
+    uint32_t signature; // INDEX_NONE if there is no Signature attribute
+    uint16_t flags;
+    uint16_t is_method;
+};
+
+inline uint64_t member_key(std::string_view owner, std::string_view name, std::string_view descriptor) {
+    return hash_combine(hash_combine(hash_bytes(owner), hash_bytes(name)), hash_bytes(descriptor));
+}
+
+inline uint32_t table_size(std::size_t count) {
+    uint32_t size = 16;
+    while (size < count * 2) size <<= 1; // Load factor of at most 0.5
+    return size;
+}
+
+// Open addressing with linear probing; slots hold index + 1 (0 is empty)
+inline void table_insert(std::vector<uint32_t> & table, uint64_t key, uint32_t index) {
+    std::size_t mask = table.size() - 1;
+    std::size_t slot = key & mask;
+    while (table[slot] != 0) slot = (slot + 1) & mask;
+    table[slot] = index + 1;
+}
+
+inline uint64_t align_section(uint64_t offset) {
+    return (offset + 7) & ~(uint64_t) 7;
+}
+
+inline void write_section(std::ofstream & stream, void const* data, std::size_t size, uint64_t offset) {
+    // Pad up to the section offset
+    static const char zeros[8] = {};
+    std::size_t position = (std::size_t) stream.tellp();
+    stream.write(zeros, (std::streamsize) (offset - position));
+    stream.write(static_cast<char const*>(data), (std::streamsize) size);
+}
+
+/* Read-only memory mapping of a whole file */
+
+class MappedFile {
+public:
+    explicit MappedFile(std::string const& filename) {
+        int descriptor = ::open(filename.c_str(), O_RDONLY);
+        if (descriptor < 0) throw std::runtime_error("Cannot open " + filename);
+        struct stat status;
+        if (::fstat(descriptor, &status) != 0) {
+            ::close(descriptor);
+            throw std::runtime_error("Cannot open " + filename);
+        }
+        size_ = (std::size_t) status.st_size;
+        if (size_ > 0) {
+            void * mapping = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, descriptor, 0);
+            ::close(descriptor);
+            if (mapping == MAP_FAILED) throw std::runtime_error("Cannot map " + filename);
+            data_ = static_cast<char const*>(mapping);
+        } else {
+            ::close(descriptor);
+        }
+    }
+
+    ~MappedFile() {
+        if (data_) ::munmap(const_cast<char *>(data_), size_);
+    }
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile & operator=(MappedFile const&) = delete;
+
+    char const* data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+    // Whether [offset, offset + length) lies within the file
+    bool fits(uint64_t offset, uint64_t length) const {
+        return offset <= size_ && length <= size_ - offset;
+    }
+
+    // Whether a section of records can be read in place (within the file and aligned to 8 bytes)
+    bool holds_section(uint64_t offset, uint64_t length) const {
+        return offset % 8 == 0 && fits(offset, length);
+    }
+
+private:
+    char const* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+/* Checked reads from mapped files
+ *
+ * Mapped files are not parsed when they are opened, so offsets, lengths and record indices taken from
+ * them are checked where they are used. A corrupt file raises an error instead of reading out of bounds.
+ */
+
+// Hash tables are probed with a mask, so their size must be a power of two
+inline bool is_table_size(uint32_t size) {
+    return size != 0 && (size & (size - 1)) == 0;
+}
+
+// index, if it refers to one of count records (what names the file type, for the error)
+inline uint32_t checked_index(uint64_t index, uint64_t count, char const* what) {
+    if (index >= count) throw std::runtime_error(std::string("Corrupt ") + what + " (record " + std::to_string(index) + " of " + std::to_string(count) + ")");
+    return (uint32_t) index;
+}
+
+// u4 length + bytes at offset in a strings section of the given size
+inline std::string_view checked_string(char const* strings, uint64_t size, uint32_t offset, char const* what) {
+    uint32_t length;
+    if (offset > size || size - offset < sizeof(length)) throw std::runtime_error(std::string("Corrupt ") + what + " (string offset " + std::to_string(offset) + ")");
+    std::memcpy(&length, strings + offset, sizeof(length));
+    if (length > size - offset - sizeof(length)) throw std::runtime_error(std::string("Corrupt ") + what + " (string length at offset " + std::to_string(offset) + ")");
+    return std::string_view(strings + offset + sizeof(length), length);
+}
+
+}
+
+/* Building an index */
+
+class SymbolIndexBuilder {
+public:
+    // Returns false (and ignores the class) if a class with the same name was added before
+    bool add(Class const& class_) {
+        if (!names.insert(class_.name).second) return false;
+
+        detail::IndexClass record{};
+        record.name = string(class_.name);
+        record.parent = (class_.parent.empty() || class_.name == "java.lang.Object") ? detail::INDEX_NONE : string(class_.parent);
+        record.first_interface = (uint32_t) interfaces.size();
+        record.interface_count = (uint32_t) class_.interfaces.size();
+        for (std::string const& interface : class_.interfaces) {
+            interfaces.push_back(string(interface));
+        }
+        record.first_member = (uint32_t) members.size();
+        record.field_count = (uint32_t) class_.fields.size();
+        record.method_count = (uint32_t) class_.methods.size();
+        record.flags = class_.flags.raw;
+
+        uint32_t owner = (uint32_t) classes.size();
+        for (Object const& field : class_.fields) add_member(class_, field, owner, false);
+        for (Object const& method : class_.methods) add_member(class_, method, owner, true);
+
+        classes.push_back(record);
+        return true;
+    }
+
+    std::size_t size() const { return classes.size(); }
+
+    void write(std::string const& filename) const {
+        detail::IndexHeader header{};
+        std::memcpy(header.magic, detail::INDEX_MAGIC, sizeof(header.magic));
+        header.version = detail::INDEX_VERSION;
+        header.class_count = (uint32_t) classes.size();
+        header.member_count = (uint32_t) members.size();
+        header.interface_count = (uint32_t) interfaces.size();
+        header.class_table_size = detail::table_size(classes.size());
+        header.member_table_size = detail::table_size(members.size());
+
+        // Hash tables
+        std::vector<uint32_t> class_table(header.class_table_size, 0);
+        for (std::size_t index = 0; index < classes.size(); ++index) {
+            detail::table_insert(class_table, hash_bytes(string_at(classes[index].name)), (uint32_t) index);
+        }
+        std::vector<uint32_t> member_table(header.member_table_size, 0);
+        for (std::size_t index = 0; index < members.size(); ++index) {
+            detail::IndexMember const& member = members[index];
+            uint64_t key = detail::member_key(string_at(classes[member.owner].name), string_at(member.name), string_at(member.descriptor));
+            detail::table_insert(member_table, key, (uint32_t) index);
+        }
+
+        // Section offsets
+        uint64_t offset = detail::align_section(sizeof(header));
+        header.strings_offset = offset;
+        header.strings_size = strings.size();
+        offset = detail::align_section(offset + strings.size());
+        header.classes_offset = offset;
+        offset = detail::align_section(offset + classes.size() * sizeof(detail::IndexClass));
+        header.members_offset = offset;
+        offset = detail::align_section(offset + members.size() * sizeof(detail::IndexMember));
+        header.interfaces_offset = offset;
+        offset = detail::align_section(offset + interfaces.size() * sizeof(uint32_t));
+        header.class_table_offset = offset;
+        offset = detail::align_section(offset + class_table.size() * sizeof(uint32_t));
+        header.member_table_offset = offset;
+
+        // Computed once here, so that readers need not hash the whole file
+        uint64_t hash = hash_bytes(strings);
+        hash = hash_combine(hash, hash_bytes(classes.data(), classes.size() * sizeof(detail::IndexClass)));
+        hash = hash_combine(hash, hash_bytes(members.data(), members.size() * sizeof(detail::IndexMember)));
+        hash = hash_combine(hash, hash_bytes(interfaces.data(), interfaces.size() * sizeof(uint32_t)));
+        header.content_hash = hash;
+
+        std::ofstream stream(filename, std::ios::binary | std::ios::trunc);
+        if (!stream) throw std::runtime_error("Cannot write index " + filename);
+        detail::write_section(stream, &header, sizeof(header), 0);
+        detail::write_section(stream, strings.data(), strings.size(), header.strings_offset);
+        detail::write_section(stream, classes.data(), classes.size() * sizeof(detail::IndexClass), header.classes_offset);
+        detail::write_section(stream, members.data(), members.size() * sizeof(detail::IndexMember), header.members_offset);
+        detail::write_section(stream, interfaces.data(), interfaces.size() * sizeof(uint32_t), header.interfaces_offset);
+        detail::write_section(stream, class_table.data(), class_table.size() * sizeof(uint32_t), header.class_table_offset);
+        detail::write_section(stream, member_table.data(), member_table.size() * sizeof(uint32_t), header.member_table_offset);
+        if (!stream) throw std::runtime_error("Cannot write index " + filename);
+    }
+
+private:
+    std::string strings;
+    std::unordered_map<std::string, uint32_t> string_offsets;
+    std::unordered_set<std::string> names;
+    std::vector<detail::IndexClass> classes;
+    std::vector<detail::IndexMember> members;
+    std::vector<uint32_t> interfaces;
+
+    uint32_t string(std::string const& value) {
+        auto it = string_offsets.find(value);
+        if (it != string_offsets.end()) return it->second;
+        uint32_t offset = (uint32_t) strings.size();
+        uint32_t length = (uint32_t) value.size();
+        strings.append(reinterpret_cast<char const*>(&length), sizeof(length));
+        strings.append(value);
+        string_offsets.emplace(value, offset);
+        return offset;
+    }
+
+    std::string_view string_at(uint32_t offset) const {
+        uint32_t length;
+        std::memcpy(&length, strings.data() + offset, sizeof(length));
+        return std::string_view(strings.data() + offset + sizeof(length), length);
+    }
+
+    void add_member(Class const& class_, Object const& object, uint32_t owner, bool is_method) {
+        detail::IndexMember member{};
+        member.owner = owner;
+        member.name = string(class_.constants[object.name_index].value.string);
+        member.descriptor = string(class_.constants[object.descriptor_index].value.string);
+        member.signature = detail::INDEX_NONE;
+        Attribute const* signature = object.attribute(Attribute::SIGNATURE);
+        if (signature && signature->data.size() >= 2) {
+            member.signature = string(class_.constants[parse<uint16_t>(convert<2>(signature->data))].value.string);
+        }
+        member.flags = object.flags.raw;
+        member.is_method = is_method;
+        members.push_back(member);
+    }
+};
+
+/* Reading an index */
+
+struct IndexedMember {
+    std::string_view owner;
+    std::string_view name;
+    std::string_view descriptor;
+    std::string_view signature; // Empty if not present
+    uint16_t flags;
+    bool is_method;
+};
+
+struct IndexedClass {
+    uint32_t id;
+    std::string_view name;
+    std::string_view parent; // Empty for java.lang.Object
+    uint16_t flags;
+    uint32_t interface_count;
+    uint32_t field_count;
+    uint32_t method_count;
+};
+
+class SymbolIndex {
+public:
+    explicit SymbolIndex(std::string const& filename)
+        : file(filename) {
+        data = file.data();
+        if (file.size() < sizeof(detail::IndexHeader)) throw std::runtime_error("Invalid index " + filename);
+        header = reinterpret_cast<detail::IndexHeader const*>(data);
+        if (std::memcmp(header->magic, detail::INDEX_MAGIC, sizeof(header->magic)) != 0 || header->version != detail::INDEX_VERSION
+                || !file.holds_section(header->strings_offset, header->strings_size)
+                || !file.holds_section(header->classes_offset, (uint64_t) header->class_count * sizeof(detail::IndexClass))
+                || !file.holds_section(header->members_offset, (uint64_t) header->member_count * sizeof(detail::IndexMember))
+                || !file.holds_section(header->interfaces_offset, (uint64_t) header->interface_count * sizeof(uint32_t))
+                || !file.holds_section(header->class_table_offset, (uint64_t) header->class_table_size * sizeof(uint32_t))
+                || !file.holds_section(header->member_table_offset, (uint64_t) header->member_table_size * sizeof(uint32_t))
+                || !detail::is_table_size(header->class_table_size) || !detail::is_table_size(header->member_table_size)) {
+            throw std::runtime_error("Invalid or incompatible index " + filename);
+        }
+        classes = reinterpret_cast<detail::IndexClass const*>(data + header->classes_offset);
+        members = reinterpret_cast<detail::IndexMember const*>(data + header->members_offset);
+        interfaces = reinterpret_cast<uint32_t const*>(data + header->interfaces_offset);
+        class_table = reinterpret_cast<uint32_t const*>(data + header->class_table_offset);
+        member_table = reinterpret_cast<uint32_t const*>(data + header->member_table_offset);
+    }
+
+    SymbolIndex(SymbolIndex const&) = delete;
+    SymbolIndex & operator=(SymbolIndex const&) = delete;
+
+    std::size_t class_count() const { return header->class_count; }
+    std::size_t member_count() const { return header->member_count; }
+
+    // Hash of the indexed data, stored in the header when the index was built (changes whenever the indexed corpus does)
+    uint64_t fingerprint() const { return header->content_hash; }
+
+    IndexedClass get_class(uint32_t id) const {
+        detail::IndexClass const& record = classes[detail::checked_index(id, header->class_count, "index")];
+        return IndexedClass{id, string(record.name), string(record.parent), record.flags, record.interface_count, record.field_count, record.method_count};
+    }
+
+    std::optional<IndexedClass> find_class(std::string_view name) const {
+        std::size_t mask = header->class_table_size - 1;
+        // A corrupt table might have no empty slot, so no slot is probed twice
+        for (std::size_t slot = hash_bytes(name) & mask, probes = 0; probes <= mask && class_table[slot] != 0; slot = (slot + 1) & mask, ++probes) {
+            uint32_t id = detail::checked_index(class_table[slot] - 1, header->class_count, "index");
+            if (string(classes[id].name) == name) return get_class(id);
+        }
+        return std::nullopt;
+    }
+
+    std::string_view interface(IndexedClass const& class_, uint32_t index) const {
+        uint64_t position = (uint64_t) classes[detail::checked_index(class_.id, header->class_count, "index")].first_interface + index;
+        return string(interfaces[detail::checked_index(position, header->interface_count, "index")]);
+    }
+
+    // Fields come first, followed by the methods
+    IndexedMember member(IndexedClass const& class_, uint32_t index) const {
+        uint64_t position = (uint64_t) classes[detail::checked_index(class_.id, header->class_count, "index")].first_member + index;
+        return get_member(detail::checked_index(position, header->member_count, "index"));
+    }
+
+    // Member declared in exactly this class
+    std::optional<IndexedMember> find_member(std::string_view owner, std::string_view name, std::string_view descriptor) const {
+        std::size_t mask = header->member_table_size - 1;
+        for (std::size_t slot = detail::member_key(owner, name, descriptor) & mask, probes = 0; probes <= mask && member_table[slot] != 0; slot = (slot + 1) & mask, ++probes) {
+            uint32_t index = detail::checked_index(member_table[slot] - 1, header->member_count, "index");
+            detail::IndexMember const& record = members[index];
+            if (string(record.name) == name && string(record.descriptor) == descriptor && string(owner_record(record).name) == owner) {
+                return get_member(index);
+            }
+        }
+        return std::nullopt;
+    }
+
+    // Member declared in the class or inherited from one of its superclasses or superinterfaces
+    std::optional<IndexedMember> resolve_member(std::string_view owner, std::string_view name, std::string_view descriptor, std::size_t depth = 0) const {
+        if (depth > 64) return std::nullopt; // Broken (cyclic) hierarchies
+        std::optional<IndexedMember> member = find_member(owner, name, descriptor);
+        if (member) return member;
+        std::optional<IndexedClass> class_ = find_class(owner);
+        if (!class_) return std::nullopt;
+        if (!class_->parent.empty()) {
+            member = resolve_member(class_->parent, name, descriptor, depth + 1);
+            if (member) return member;
+        }
+        for (uint32_t index = 0; index < class_->interface_count; ++index) {
+            member = resolve_member(interface(*class_, index), name, descriptor, depth + 1);
+            if (member) return member;
+        }
+        return std::nullopt;
+    }
+
+private:
+    detail::MappedFile file;
+    char const* data;
+    detail::IndexHeader const* header;
+    detail::IndexClass const* classes;
+    detail::IndexMember const* members;
+    uint32_t const* interfaces;
+    uint32_t const* class_table;
+    uint32_t const* member_table;
+
+    std::string_view string(uint32_t offset) const {
+        if (offset == detail::INDEX_NONE) return std::string_view();
+        return detail::checked_string(data + header->strings_offset, header->strings_size, offset, "index");
+    }
+
+    detail::IndexClass const& owner_record(detail::IndexMember const& member) const {
+        return classes[detail::checked_index(member.owner, header->class_count, "index")];
+    }
+
+    IndexedMember get_member(uint32_t index) const {
+        detail::IndexMember const& record = members[detail::checked_index(index, header->member_count, "index")];
+        return IndexedMember{string(owner_record(record).name), string(record.name), string(record.descriptor), string(record.signature), record.flags, record.is_method != 0};
+    }
+};
+
+// Index all classes of a corpus (directory, jar or class file). Returns the number of indexed classes.
+std::size_t build_symbol_index(std::string const& corpus_path, std::string const& index_path) {
+    Corpus corpus(corpus_path);
+    SymbolIndexBuilder builder;
+    for (CorpusEntry const& entry : corpus) {
+        try {
+            if (!builder.add(read_class(Corpus::read(entry)))) {
+                std::cerr << "Skipping duplicate class in " << entry.display_name() << std::endl;
+            }
+        } catch (std::exception const& error) {
+            std::cerr << "Skipping " << entry.display_name() << ": " << error.what() << std::endl;
+        }
+    }
+    builder.write(index_path);
+    return builder.size();
+}
+
+}
+
+#endif // JJDE_INDEX_HPP
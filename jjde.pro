@@ -6,20 +6,50 @@ CONFIG -= qt
 SOURCES += \
     main.cpp
 
-QMAKE_CXXFLAGS += -std=c++14 -g
+QMAKE_CXXFLAGS += -std=c++17 -g -pthread
+
+LIBS += -lz -pthread
+
+# Statistics for --stats (stats.hpp), optionally with counted allocations
+stats|stats_allocations: DEFINES += JJDE_ENABLE_STATS
+stats_allocations: DEFINES += JJDE_COUNT_ALLOCATIONS
 
 HEADERS += \
+    version.hpp \
+    stats.hpp \
+    format.hpp \
     flags.hpp \
     bytes.hpp \
+    hash.hpp \
+    cache.hpp \
     constants.hpp \
     objects.hpp \
     types.hpp \
+    type_table.hpp \
+    signatures.hpp \
     class.hpp \
+    context.hpp \
+    parallel.hpp \
+    corpus.hpp \
+    search.hpp \
+    index.hpp \
+    hierarchy.hpp \
+    callgraph.hpp \
     disassembler.hpp \
+    debug.hpp \
+    fingerprint.hpp \
+    emit.hpp \
+    dedup.hpp \
+    expressions.hpp \
     instructions.hpp \
     annotater.hpp \
+    decompiler.hpp \
+    pipeline.hpp \
+    diff.hpp \
     simulation.hpp \
-    analysis.hpp
+    stack.hpp \
+    analysis.hpp \
+    passes.hpp
 
 OTHER_FILES += \
     resources/Example.java \
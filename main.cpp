@@ -12,139 +12,364 @@
 
 #include "analysis.hpp"
 #include "annotater.hpp"
+#include "cache.hpp"
+#include "callgraph.hpp"
 #include "class.hpp"
+#include "corpus.hpp"
+#include "decompiler.hpp"
+#include "dedup.hpp"
+#include "diff.hpp"
+#include "emit.hpp"
 #include "disassembler.hpp"
 #include "flags.hpp"
+#include "hierarchy.hpp"
+#include "index.hpp"
 #include "instructions.hpp"
 #include "objects.hpp"
+#include "pipeline.hpp"
+#include "search.hpp"
+#include "simulation.hpp"
+#include "stats.hpp"
 #include "types.hpp"
 
 
-int main(int argc, char *argv[]) {
+int usage(char const* program) {
+    std::cerr << "Usage:" << std::endl
+              << "    " << program << " <file.class | directory | file.jar> [--index <index file>] [--cache <directory> [--cache-size <MiB>]]" << std::endl
+              << "        [--jobs <threads>] [--memory-budget <MiB>] [--format <text | jsonl | binary | dot | edges>]" << std::endl
+              << "        [--public-only] [--skip-synthetic] [--stats]" << std::endl
+              << "    " << program << " --diff <old corpus> <new corpus> [--index <index file>]" << std::endl
+              << "    " << program << " --hierarchy <corpus> <class> [<other class>]" << std::endl
+              << "    " << program << " --scan <corpus>" << std::endl
+              << "    " << program << " --search <corpus> [--literals] <string> [<string> ...]" << std::endl
+              << "    " << program << " --build-index <directory | file.jar> <index file>" << std::endl
+              << "    " << program << " --build-callgraph <directory | file.jar> <call graph file>" << std::endl
+              << "    " << program << " --callers <call graph file> <class> <method> [<descriptor>]" << std::endl
+              << "    " << program << " --lookup <index file> <class> [<member> [<descriptor>]]" << std::endl;
+    return 1;
+}
 
-    if (argc <= 1) {
-        std::cerr << "Usage:" << std::endl
-                  << "    " << argv[0] << " <file.class>" << std::endl;
-        return 1;
+// format: text, jsonl or binary (see emit.hpp), dot or edges (code flow graphs only)
+int decompile(std::string const& path, std::string const& format, jjde::FlagFilter const& filter, jjde::SymbolIndex const* symbols, jjde::ResultCache * cache, jjde::PipelineOptions const& options) {
+    jjde::Corpus corpus(path);
+
+    // Everything that changes the output besides the class file itself (only needed for cache keys)
+    std::string options_key;
+    if (cache) {
+        if (symbols) options_key += "index=" + jjde::hash_to_string(symbols->fingerprint());
+        if (format != "text") options_key += "format=" + format;
+        if (filter.required != 0 || filter.excluded != 0) options_key += "filter=" + std::to_string(filter.required) + "/" + std::to_string(filter.excluded);
     }
 
-    jjde::Class class_ = jjde::read_class(argv[1]);
+    // Identical method bodies (within and across classes) are rendered once
+    jjde::MethodBodies bodies(options.memory_budget / 4);
 
-    // Write java code.
+    // Cached output skips parsing and rendering entirely
+    std::vector<uint64_t> keys(cache ? corpus.size() : 0);
+    auto parse = [&](jjde::PipelineItem & item) {
+        if (cache) {
+            // Records name their input, so the same class at another path must not hit the cache
+            bool records = (format == "jsonl" || format == "binary");
+            keys[item.entry] = jjde::ResultCache::key(item.bytes, records ? options_key + "source=" + corpus[item.entry].display_name() : options_key);
+            std::optional<std::string> cached = cache->get(keys[item.entry]);
+            if (cached) {
+                item.output = std::move(*cached);
+                item.rendered = true;
+                return;
+            }
+        }
+        item.class_.reset(new jjde::Class(jjde::read_class(item.bytes)));
+    };
+    auto render = [&](jjde::PipelineItem & item) {
+        if (format == "dot" || format == "edges") {
+            std::ostringstream output;
+            jjde::write_class_flows(output, *item.class_, format, filter);
+            item.output = output.str();
+            if (cache) cache->put(keys[item.entry], item.output);
+            return;
+        } else if (format != "text") {
+            jjde::emit_class(*jjde::make_record_writer(format, item.output), *item.class_, corpus[item.entry].display_name(), filter);
+            if (cache) cache->put(keys[item.entry], item.output);
+            return;
+        }
+        std::ostringstream output;
+        jjde::write_class(output, *item.class_, symbols, &bodies, filter);
+        item.output = output.str();
+        if (cache) cache->put(keys[item.entry], item.output);
+    };
 
-    std::cout << std::endl;
-    std::cout << argv[1] << std::endl;
-    std::cout << "---------------------------------------------------------------------------------------------" << std::endl;
-    /* Attributes to check:
-     *     Code                Method code (+ more information)
-     *     ConstantValue       Constant values for primitve 'final' fields
-     *     Exceptions          Exceptions thrown by a method
-     *     InnerClasses        Inner classes
-     *     LineNumberTable     Line numbers (debugging information)
-     *     LocalVariableTable  Local variable names (debugging information)
-     *     SourceFile          Source code file name (.java)
-     *     Synthetic           Field or method is compiler-generated
-     */
-
-    // Write class name and parent
-    std::cout << class_.flags.to_string() << " class " << class_.name;
-    if (class_.parent != "java.lang.Object") {
-        std::cout << " extends " << class_.parent;
-    }
-
-    // Write interfaces
-    if (class_.interfaces.size() > 0) {
-        std::cout << " implements " << class_.interfaces[0];
-        for (std::size_t index = 1; index < class_.interfaces.size(); ++index) {
-            std::cout << ", " << class_.interfaces[index];
+    // Write java code.
+    int status = 0;
+    auto write = [&](jjde::PipelineItem const& item) {
+        if (!item.error.empty()) {
+            std::cerr << "Cannot decompile " << corpus[item.entry].display_name() << ": " << item.error << std::endl;
+            status = 1;
+            if (format == "jsonl" || format == "binary") {
+                std::string record;
+                jjde::emit_error(*jjde::make_record_writer(format, record), "Cannot decompile " + corpus[item.entry].display_name() + ": " + item.error);
+                std::cout << record;
+            }
+            return;
         }
+        if (format != "text" || item.output.empty()) {
+            std::cout << item.output; // Classes rejected by the filter have no output
+            return;
+        }
+        std::cout << std::endl;
+        std::cout << corpus[item.entry].display_name() << std::endl;
+        std::cout << "---------------------------------------------------------------------------------------------" << std::endl;
+        std::cout << item.output;
+        std::cout << "---------------------------------------------------------------------------------------------" << std::endl;
+        std::cout << std::endl;
+    };
+
+    if (format == "binary") std::cout << jjde::BinaryWriter::magic;
+    jjde::Pipeline(corpus, options).run(parse, render, write);
+
+    if (bodies.method_count() > 0) {
+        std::cerr << "Deduplicated " << bodies.duplicate_count() << " of " << bodies.method_count() << " method bodies ("
+                  << std::fixed << std::setprecision(1) << 100.0 * bodies.duplicate_count() / bodies.method_count() << "%)" << std::endl;
     }
-    std::cout << " {" << std::endl;
+    return status;
+}
 
-    // Fields
-    for (jjde::Object const& field : class_.fields) {
-        // Flags
-        std::string flags = field.flags.to_string();
-        if (flags.size() > 0) flags += " ";
+int hierarchy(std::string const& corpus, std::vector<std::string> const& query) {
+    jjde::ClassHierarchy graph{jjde::Corpus(corpus)};
 
-        // Type
-        std::string type = jjde::decode_type(class_.constants[field.descriptor_index].value.string).to_string();
-        auto it = std::find_if(field.attributes.begin(), field.attributes.end(), [&class_](jjde::Attribute const& attr){ return (class_.constants[attr.name_index].value.string == "Signature"); });
-        if (it != field.attributes.end()) {
-            // Get signature instead of type (fixes generics type erasure)
-            type = jjde::decode_type(class_.constants[jjde::parse<uint16_t>(jjde::convert<2>(it->data))].value.string).to_string();
+    std::vector<uint32_t> ids;
+    for (std::string const& name : query) {
+        std::optional<uint32_t> id = graph.id(name);
+        if (!id) {
+            std::cerr << "Class " << name << " is not in the hierarchy" << std::endl;
+            return 1;
         }
+        ids.push_back(*id);
+    }
 
-        // Name
-        std::string name = class_.constants[field.name_index].value.string;
+    if (ids.size() == 2) {
+        uint32_t common = graph.common_superclass(ids[0], ids[1]);
+        std::cout << query[0] << (graph.is_subtype(ids[0], ids[1]) ? " is" : " is not") << " a subtype of " << query[1] << std::endl;
+        std::cout << query[1] << (graph.is_subtype(ids[1], ids[0]) ? " is" : " is not") << " a subtype of " << query[0] << std::endl;
+        std::cout << "Common superclass: " << (common == jjde::ClassHierarchy::NONE ? "(unknown)" : graph.name(common)) << std::endl;
+        return 0;
+    }
 
-        // Output (without value)
-        std::cout << "    " << flags << type << " " << name;
+    // Supertypes and implementors
+    std::cout << (graph.is_known(ids[0]) ? "" : "(external) ") << (graph.is_interface(ids[0]) ? "interface " : "class ") << query[0] << std::endl;
+    std::size_t steps = 0; // Malformed corpora may contain cycles
+    for (uint32_t super = graph.superclass(ids[0]); super != jjde::ClassHierarchy::NONE && steps < graph.size(); super = graph.superclass(super), ++steps) {
+        std::cout << "    extends " << graph.name(super) << std::endl;
+    }
+    std::pair<uint32_t const*, uint32_t const*> supertypes = graph.supertypes_of(ids[0]);
+    for (uint32_t const* it = supertypes.first; it != supertypes.second; ++it) {
+        if (*it != graph.superclass(ids[0])) std::cout << "    implements " << graph.name(*it) << std::endl;
+    }
+    for (uint32_t implementor : graph.implementors(ids[0])) {
+        std::cout << "    implemented by " << graph.name(implementor) << std::endl;
+    }
+    return 0;
+}
 
-        // Check for default value of primitive types in the ConstantValue attribute
-        it = std::find_if(field.attributes.begin(), field.attributes.end(), [&class_](jjde::Attribute const& attr){ return (class_.constants[attr.name_index].value.string == "ConstantValue"); });
-        if (it != field.attributes.end()) {
-            std::cout << " = " << class_.constants[jjde::parse<uint16_t>(jjde::convert<2>(it->data))].to_string(class_.constants);
+// List the declarations of every class, skipping all code
+int scan(std::string const& path) {
+    jjde::Corpus corpus(path);
+    std::vector<std::string> outlines(corpus.size());
+    jjde::parallel_for(corpus.size(), [&](std::size_t index) {
+        std::ostringstream output;
+        try {
+            jjde::write_outline(output, jjde::scan_class(corpus.read(index)));
+        } catch (std::exception const& error) {
+            output << "// Skipping " << corpus[index].display_name() << ": " << error.what() << std::endl;
         }
+        outlines[index] = output.str();
+    });
+    for (std::string const& outline : outlines) {
+        std::cout << outline;
+    }
+    return 0;
+}
 
-        std::cout << ";" << std::endl;
+std::string describe_method(jjde::CallGraphNode const& method) {
+    std::string name = (method.owner.empty() ? "<dynamic>" : std::string(method.owner)) + "." + std::string(method.name);
+    return jjde::intern_type(method.descriptor)->to_string(name);
+}
+
+int callers(std::string const& graph_file, std::vector<std::string> const& query) {
+    jjde::CallGraph graph(graph_file);
+
+    std::vector<jjde::CallGraphNode> methods;
+    if (query.size() > 2) {
+        std::optional<jjde::CallGraphNode> method = graph.find(query[0], query[1], query[2]);
+        if (method) methods.push_back(*method);
+    } else {
+        methods = graph.find(query[0], query[1]);
+    }
+    if (methods.empty()) {
+        std::cerr << "Method " << query[0] << "." << query[1] << " is not in the call graph" << std::endl;
+        return 1;
+    }
+
+    for (jjde::CallGraphNode const& method : methods) {
+        std::vector<jjde::CallGraphEdge> edges = graph.callers(method.id);
+        std::cout << describe_method(method) << ": " << edges.size() << " callers" << std::endl;
+        for (jjde::CallGraphEdge const& edge : edges) {
+            std::cout << "    " << describe_method(graph.method(edge.method)) << " (" << jjde::Instruction::name[edge.operation] << ")" << std::endl;
+        }
     }
+    return 0;
+}
+
+int lookup(std::string const& index_file, std::vector<std::string> const& query) {
+    jjde::SymbolIndex symbols(index_file);
 
-    // Methods
-    for (jjde::Object const& method : class_.methods) {
-        // Flags
-        std::string flags = method.flags.to_string();
-        if (flags.size() > 0) flags += " ";
+    std::optional<jjde::IndexedClass> class_ = symbols.find_class(query[0]);
+    if (!class_) {
+        std::cerr << "Class " << query[0] << " is not in the index" << std::endl;
+        return 1;
+    }
 
-        // Name
-        std::string name = class_.constants[method.name_index].value.string;
-        std::string::size_type dollar = name.find("$"); // Function overloads are numbered using $0, $1, etc.
-        if (dollar != std::string::npos) {
-            name = name.substr(0, dollar);
+    // Members
+    if (query.size() > 1) {
+        bool found = false;
+        for (uint32_t index = 0; index < class_->field_count + class_->method_count; ++index) {
+            jjde::IndexedMember member = symbols.member(*class_, index);
+            if (member.name != query[1] || (query.size() > 2 && member.descriptor != query[2])) continue;
+            std::string flags = jjde::Flags(member.flags, member.is_method ? jjde::Flags::METHOD : jjde::Flags::FIELD).to_string();
+            std::string signature(member.signature.empty() ? member.descriptor : member.signature);
+            std::cout << flags << (flags.empty() ? "" : " ") << jjde::intern_type(signature)->to_string(std::string(member.name)) << std::endl;
+            found = true;
         }
+        if (!found) {
+            std::cerr << "Member " << query[1] << " of class " << query[0] << " is not in the index" << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // Class
+    std::cout << jjde::Flags(class_->flags, jjde::Flags::CLASS).to_string() << " class " << class_->name;
+    if (!class_->parent.empty() && class_->parent != "java.lang.Object") std::cout << " extends " << class_->parent;
+    for (uint32_t index = 0; index < class_->interface_count; ++index) {
+        std::cout << (index == 0 ? " implements " : ", ") << symbols.interface(*class_, index);
+    }
+    std::cout << std::endl;
+    std::cout << "    " << class_->field_count << " fields, " << class_->method_count << " methods" << std::endl;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<std::string> arguments(argv + 1, argv + argc);
+    if (arguments.empty()) {
+        return usage(argv[0]);
+    }
+
+    if (arguments[0] == "--scan") {
+        if (arguments.size() != 2) return usage(argv[0]);
+        return scan(arguments[1]);
+    }
 
-        // Type
-        jjde::Type jjde_type = jjde::decode_type(class_.constants[method.descriptor_index].value.string);
-        auto it = std::find_if(method.attributes.begin(), method.attributes.end(), [&class_](jjde::Attribute const& attr){ return (class_.constants[attr.name_index].value.string == "Signature"); });
-        if (it != method.attributes.end()) {
-            // Get signature instead of type (fixes generics type erasure)
-            jjde_type = jjde::decode_type(class_.constants[jjde::parse<uint16_t>(jjde::convert<2>(it->data))].value.string);
+    if (arguments[0] == "--search") {
+        if (arguments.size() < 3) return usage(argv[0]);
+        bool literals_only = arguments[2] == "--literals";
+        std::vector<std::string> patterns(arguments.begin() + (literals_only ? 3 : 2), arguments.end());
+        if (patterns.empty()) return usage(argv[0]);
+        jjde::Corpus corpus(arguments[1]);
+        for (jjde::SearchMatch const& match : jjde::search_corpus(corpus, patterns, literals_only)) {
+            std::cout << corpus[match.entry].display_name() << " (" << match.class_name << "): " << jjde::encode(match.string) << std::endl;
         }
+        return 0;
+    }
+
+    if (arguments[0] == "--build-index") {
+        if (arguments.size() != 3) return usage(argv[0]);
+        std::size_t count = jjde::build_symbol_index(arguments[1], arguments[2]);
+        std::cerr << "Indexed " << count << " classes" << std::endl;
+        return 0;
+    }
 
-        //  - Get argument names
-        std::vector<std::string> argument_names;
-        for (std::size_t index = 0; index < jjde_type.argument_types.size(); ++index) {
-            argument_names.push_back("arg" + std::to_string(index));
+    if (arguments[0] == "--diff") {
+        std::unique_ptr<jjde::SymbolIndex> symbols;
+        if (arguments.size() == 5 && arguments[3] == "--index") {
+            symbols.reset(new jjde::SymbolIndex(arguments[4]));
+        } else if (arguments.size() != 3) {
+            return usage(argv[0]);
         }
+        jjde::Corpus old_corpus(arguments[1]);
+        jjde::Corpus new_corpus(arguments[2]);
+        jjde::CorpusDiff diff = jjde::diff_corpora(old_corpus, new_corpus);
+        std::cout << "--- " << arguments[1] << std::endl << "+++ " << arguments[2] << std::endl;
+        jjde::write_diff(std::cout, new_corpus, diff, symbols.get());
+        return 0;
+    }
 
-        //  - Get proper type
-        std::string signature = jjde_type.to_string(name, argument_names);
+    if (arguments[0] == "--hierarchy") {
+        if (arguments.size() < 3 || arguments.size() > 4) return usage(argv[0]);
+        return hierarchy(arguments[1], std::vector<std::string>(arguments.begin() + 2, arguments.end()));
+    }
+
+    if (arguments[0] == "--build-callgraph") {
+        if (arguments.size() != 3) return usage(argv[0]);
+        std::size_t count = jjde::build_call_graph(arguments[1], arguments[2]);
+        std::cerr << "Wrote call graph with " << count << " methods" << std::endl;
+        return 0;
+    }
 
-        // Output (without value)
-        std::cout << "    " << flags << signature;
+    if (arguments[0] == "--callers") {
+        if (arguments.size() < 4 || arguments.size() > 5) return usage(argv[0]);
+        return callers(arguments[1], std::vector<std::string>(arguments.begin() + 2, arguments.end()));
+    }
 
-        // Output code
-        it = std::find_if(method.attributes.begin(), method.attributes.end(), [&class_](jjde::Attribute const& attr){ return (class_.constants[attr.name_index].value.string == "Code"); });
-        if (it != method.attributes.end()) {
-            std::cout << " {" << std::endl;
-            jjde::Bytecode bytecode = jjde::disassemble(it->data);
-            jjde::Code code = jjde::annotate(class_, bytecode, method.flags.is_static);
-            std::cout << code.to_string();
-            std::cout << "    }" << std::endl;
+    if (arguments[0] == "--lookup") {
+        if (arguments.size() < 3 || arguments.size() > 5) return usage(argv[0]);
+        return lookup(arguments[1], std::vector<std::string>(arguments.begin() + 2, arguments.end()));
+    }
 
-            std::cout << "    >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>" << std::endl;
-            jjde::_visualize_code_flow(std::move(bytecode));
-            std::cout << "    <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<" << std::endl;
+    std::unique_ptr<jjde::SymbolIndex> symbols;
+    std::string cache_directory;
+    uint64_t cache_size = 256;
+    jjde::PipelineOptions options;
+    std::string format = "text";
+    jjde::FlagFilter filter;
+    bool stats = false;
+    for (std::size_t index = 1; index < arguments.size(); index += 2) {
+        // Options without a value
+        if (arguments[index] == "--public-only") {
+            filter.required |= jjde::Flags::PUBLIC;
+            --index;
+            continue;
+        } else if (arguments[index] == "--skip-synthetic") {
+            filter.excluded |= jjde::Flags::SYNTHETIC;
+            --index;
+            continue;
+        } else if (arguments[index] == "--stats") {
+            stats = true;
+            --index;
+            continue;
+        }
+        if (index + 1 >= arguments.size()) return usage(argv[0]);
+        if (arguments[index] == "--index") {
+            symbols.reset(new jjde::SymbolIndex(arguments[index + 1]));
+        } else if (arguments[index] == "--cache") {
+            cache_directory = arguments[index + 1];
+        } else if (arguments[index] == "--cache-size") {
+            cache_size = std::stoull(arguments[index + 1]);
+        } else if (arguments[index] == "--jobs") {
+            options.threads = std::stoul(arguments[index + 1]);
+        } else if (arguments[index] == "--format") {
+            format = arguments[index + 1];
+            if (format != "text" && format != "jsonl" && format != "binary" && format != "dot" && format != "edges") return usage(argv[0]);
+        } else if (arguments[index] == "--memory-budget") {
+            options.memory_budget = std::stoull(arguments[index + 1]) << 20;
         } else {
-            std::cout << " {}" << std::endl;
+            return usage(argv[0]);
         }
-
-        std::cout << std::endl;
     }
 
-    std::cout << "}" << std::endl;
-    std::cout << "---------------------------------------------------------------------------------------------" << std::endl;
-    std::cout << std::endl;
-
-    return 0;
+    std::unique_ptr<jjde::ResultCache> cache;
+    if (!cache_directory.empty()) {
+        cache.reset(new jjde::ResultCache(cache_directory, cache_size << 20));
+    }
+    int status = decompile(arguments[0], format, filter, symbols.get(), cache.get(), options);
+    if (stats) jjde::stats::report(std::cerr);
+    return status;
 }
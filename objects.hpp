@@ -5,6 +5,7 @@
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <memory_resource>
 #include <sstream>
 #include <utility>
 #include <vector>
@@ -17,24 +18,82 @@ namespace jjde {
 /* Attributes */
 
 struct Attribute {
+    // Attributes that are looked up by name (the kind of an attribute is resolved once per class from
+    // its name, see AttributeKinds)
+    enum Kind : uint8_t {
+        CODE,
+        CONSTANT_VALUE,
+        SIGNATURE,
+        EXCEPTIONS,
+        LINE_NUMBER_TABLE,
+        LOCAL_VARIABLE_TABLE,
+        STACK_MAP_TABLE,
+        SOURCE_FILE,
+        OTHER // Also the number of well-known kinds
+    };
+    static constexpr std::array<char const*, OTHER> names = {{
+        "Code", "ConstantValue", "Signature", "Exceptions", "LineNumberTable", "LocalVariableTable", "StackMapTable", "SourceFile"
+    }};
+
     uint16_t name_index; // for the constant pool
-    std::vector<unsigned char> data;
+    std::pmr::vector<unsigned char> data;
 };
 
-Attribute read_attribute(std::ifstream & stream) {
+// Attribute lists (and their payloads) of a class are allocated from the arena of the class
+typedef std::pmr::vector<Attribute> AttributeList;
+
+/* Attribute kinds
+ *
+ * Indexed by constant pool index: the kind of attribute that each entry names (OTHER for entries that
+ * are not the name of a well-known attribute). Built once per class (see resolve_attribute_kinds), so
+ * that finding an attribute of a given kind never compares strings.
+ */
+
+typedef std::vector<Attribute::Kind> AttributeKinds;
+
+inline Attribute::Kind attribute_kind(AttributeKinds const& kinds, Attribute const& attribute) {
+    return attribute.name_index < kinds.size() ? kinds[attribute.name_index] : Attribute::OTHER;
+}
+
+// First attribute of the given kind, or nullptr
+inline Attribute const* find_attribute(AttributeList const& attributes, AttributeKinds const& kinds, Attribute::Kind kind) {
+    for (Attribute const& attribute : attributes) {
+        if (attribute_kind(kinds, attribute) == kind) return &attribute;
+    }
+    return nullptr;
+}
+
+Attribute read_attribute(std::istream & stream, std::pmr::memory_resource * resource = std::pmr::get_default_resource()) {
     uint16_t name_index = parse<uint16_t>(extract<2>(stream));
     uint32_t length = parse<uint32_t>(extract<4>(stream));
-    std::vector<unsigned char> data = extract(stream, length);
-
-    return Attribute{name_index, data};
+    return Attribute{name_index, extract(stream, length, resource)};
 }
 
-std::vector<Attribute> read_attribute_block(std::ifstream & stream) {
-    std::vector<Attribute> attributes;
+/* Attribute filters
+ *
+ * Indexed by constant pool index: true for the names of the attributes that should be kept. The
+ * payloads of all other attributes are skipped without being copied. A null filter keeps everything.
+ */
+
+typedef std::vector<bool> AttributeFilter;
+
+AttributeList read_attribute_block(std::istream & stream, AttributeFilter const* filter = nullptr, std::pmr::memory_resource * resource = std::pmr::get_default_resource()) {
+    AttributeList attributes(resource);
 
     uint16_t count = parse<uint16_t>(extract<2>(stream));
+    attributes.reserve(count);
     for (uint16_t id = 0; id < count; ++id) {
-        attributes.push_back(read_attribute(stream));
+        if (!filter) {
+            attributes.push_back(read_attribute(stream, resource));
+            continue;
+        }
+        uint16_t name_index = parse<uint16_t>(extract<2>(stream));
+        uint32_t length = parse<uint32_t>(extract<4>(stream));
+        if (name_index < filter->size() && (*filter)[name_index]) {
+            attributes.push_back(Attribute{name_index, extract(stream, length, resource)});
+        } else {
+            skip(stream, length);
+        }
     }
 
     return attributes;
@@ -46,25 +105,46 @@ struct Object {
     Flags flags;
     uint16_t name_index; // for the constant pool
     uint16_t descriptor_index; // for the constant pool
-    std::vector<Attribute> attributes;
+    AttributeList attributes;
+
+    // Position (plus one) in attributes of the first attribute of each well-known kind, 0 if there is
+    // none. Filled in by index_attributes when the class is read.
+    std::array<uint16_t, Attribute::OTHER> attribute_positions{};
+
+    void index_attributes(AttributeKinds const& kinds) {
+        attribute_positions.fill(0);
+        for (std::size_t position = attributes.size(); position-- > 0;) {
+            Attribute::Kind kind = attribute_kind(kinds, attributes[position]);
+            if (kind != Attribute::OTHER) attribute_positions[kind] = (uint16_t) (position + 1);
+        }
+    }
+
+    Attribute const* attribute(Attribute::Kind kind) const {
+        uint16_t position = attribute_positions[kind];
+        return position == 0 ? nullptr : &attributes[position - 1];
+    }
 };
 
-Object read_object(std::ifstream & stream) {
-    Flags flags(extract<2>(stream), false);
+Object read_object(std::istream & stream, Flags::Context context, AttributeFilter const* filter = nullptr, std::pmr::memory_resource * resource = std::pmr::get_default_resource()) {
+    Flags flags(extract<2>(stream), context);
     uint16_t name_index = parse<uint16_t>(extract<2>(stream));
     uint16_t descriptor_index = parse<uint16_t>(extract<2>(stream));
 
-    std::vector<Attribute> attributes = read_attribute_block(stream);
+    AttributeList attributes = read_attribute_block(stream, filter, resource);
 
-    return Object{flags, name_index, descriptor_index, attributes};
+    return Object{flags, name_index, descriptor_index, std::move(attributes)};
 }
 
-std::vector<Object> read_object_block(std::ifstream & stream) {
-    std::vector<Object> objects;
+typedef std::pmr::vector<Object> ObjectList;
+
+// context: FIELD or METHOD
+ObjectList read_object_block(std::istream & stream, Flags::Context context, AttributeFilter const* filter = nullptr, std::pmr::memory_resource * resource = std::pmr::get_default_resource()) {
+    ObjectList objects(resource);
 
     uint16_t count = parse<uint16_t>(extract<2>(stream));
+    objects.reserve(count);
     for (uint16_t id = 0; id < count; ++id) {
-        objects.push_back(read_object(stream));
+        objects.push_back(read_object(stream, context, filter, resource));
     }
 
     return objects;
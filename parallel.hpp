@@ -0,0 +1,57 @@
+#ifndef JJDE_PARALLEL_HPP
+#define JJDE_PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace jjde {
+
+/* Parallel loops
+ *
+ * parallel_for(count, function) calls function(index) for every index in [0, count), distributing the
+ * indices dynamically over a number of threads (so that a few large classes do not hold up the rest).
+ * The first exception thrown by any call is rethrown once all threads have finished.
+ */
+
+inline std::size_t default_thread_count() {
+    return std::max<std::size_t>(1, std::thread::hardware_concurrency());
+}
+
+template <typename Function>
+void parallel_for(std::size_t count, Function function, std::size_t threads = default_thread_count()) {
+    threads = std::min(threads, count);
+    if (threads <= 1) {
+        for (std::size_t index = 0; index < count; ++index) function(index);
+        return;
+    }
+
+    std::atomic<std::size_t> next{0};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto worker = [&]() {
+        for (std::size_t index; (index = next.fetch_add(1, std::memory_order_relaxed)) < count;) {
+            try {
+                function(index);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) error = std::current_exception();
+                next.store(count, std::memory_order_relaxed); // Stop handing out work
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (std::size_t thread = 1; thread < threads; ++thread) pool.emplace_back(worker);
+    worker();
+    for (std::thread & thread : pool) thread.join();
+    if (error) std::rethrow_exception(error);
+}
+
+}
+
+#endif // JJDE_PARALLEL_HPP
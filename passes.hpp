@@ -0,0 +1,161 @@
+#ifndef JJDE_PASSES_HPP
+#define JJDE_PASSES_HPP
+
+#include <array>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "analysis.hpp"
+#include "annotater.hpp"
+#include "class.hpp"
+#include "context.hpp"
+#include "debug.hpp"
+#include "disassembler.hpp"
+#include "index.hpp"
+#include "objects.hpp"
+
+namespace jjde {
+
+/* Method analyses
+ *
+ * Every analysis of a method's code is a pass: a result type and a function that computes it. Passes
+ * obtain the results they depend on through the MethodAnalyses they are given, so each result is
+ * computed on first use, at most once per method, and only if some output (or another pass) asks for
+ * it. Writing code flow graphs never runs the annotator, and the disassembly is shared between all
+ * passes instead of being repeated or copied by each of them.
+ *
+ *   pass          result                                     depends on
+ *   Disassembly   instructions, handlers and code attributes
+ *   Debugging     line numbers and local variables           Disassembly
+ *   Flow          code flow graph                            Disassembly
+ *   FlowEdges     classified edges of the code flow graph    Flow
+ *   Rendering     annotated code, summary and code flow      Disassembly, Flow
+ *
+ * The simulation (simulation.hpp) is not a pass: it is incomplete, no output uses it, and nothing runs
+ * it. It can become a pass once some output needs the expressions it builds.
+ */
+
+class MethodAnalyses;
+
+namespace passes {
+
+enum Id { DISASSEMBLY, DEBUGGING, FLOW, FLOW_EDGES, RENDERING, COUNT };
+
+struct Disassembly {
+    static constexpr Id id = DISASSEMBLY;
+    using Result = Bytecode;
+    static Result run(MethodAnalyses & analyses);
+};
+
+struct Debugging {
+    static constexpr Id id = DEBUGGING;
+    using Result = DebugInfo;
+    static Result run(MethodAnalyses & analyses);
+};
+
+struct Flow {
+    static constexpr Id id = FLOW;
+    using Result = CodeFlow;
+    static Result run(MethodAnalyses & analyses);
+};
+
+struct FlowEdges {
+    static constexpr Id id = FLOW_EDGES;
+    using Result = std::vector<CodeFlowEdge>;
+    static Result run(MethodAnalyses & analyses);
+};
+
+struct Rendering {
+    static constexpr Id id = RENDERING;
+    using Result = std::string;
+    static Result run(MethodAnalyses & analyses);
+};
+
+}
+
+// The method must outlive the analyses, and so must the class and the symbol index (if any).
+class MethodAnalyses {
+public:
+    MethodAnalyses(Class const& class__, Object const& method_, SymbolIndex const* symbols_ = nullptr)
+        : class_(class__)
+        , method(method_)
+        , symbols(symbols_)
+        , code(method_.attribute(Attribute::CODE)) {}
+
+    MethodAnalyses(MethodAnalyses const&) = delete;
+    MethodAnalyses & operator=(MethodAnalyses const&) = delete;
+
+    Class const& class_;
+    Object const& method;
+    SymbolIndex const* symbols;
+    Attribute const* code; // nullptr for abstract and native methods, which cannot be analyzed
+
+    bool is_static() const { return method.flags.is_static(); }
+
+    // The result of the given pass (computed now, unless it was computed before)
+    template <typename Pass>
+    typename Pass::Result const& get() {
+        std::shared_ptr<void> & result = results[Pass::id];
+        if (!result) {
+            if (running[Pass::id]) throw std::logic_error("Cyclic dependency between method analyses");
+            running[Pass::id] = true;
+            try {
+                result = std::make_shared<typename Pass::Result>(Pass::run(*this));
+            } catch (...) {
+                running[Pass::id] = false;
+                throw;
+            }
+            running[Pass::id] = false;
+        }
+        return *static_cast<typename Pass::Result const*>(result.get());
+    }
+
+    template <typename Pass>
+    bool has() const {
+        return results[Pass::id] != nullptr;
+    }
+
+private:
+    std::array<std::shared_ptr<void>, passes::COUNT> results;
+    std::array<bool, passes::COUNT> running{};
+};
+
+namespace passes {
+
+Bytecode Disassembly::run(MethodAnalyses & analyses) {
+    if (!analyses.code) throw std::logic_error("Method without code cannot be analyzed");
+    return disassemble(analyses.code->data);
+}
+
+DebugInfo Debugging::run(MethodAnalyses & analyses) {
+    return DebugInfo(analyses.get<Disassembly>().attributes, analyses.class_.attribute_kinds);
+}
+
+CodeFlow Flow::run(MethodAnalyses & analyses) {
+    return CodeFlow(analyses.get<Disassembly>());
+}
+
+std::vector<CodeFlowEdge> FlowEdges::run(MethodAnalyses & analyses) {
+    return code_flow_edges(analyses.get<Flow>());
+}
+
+std::string Rendering::run(MethodAnalyses & analyses) {
+    std::ostringstream output;
+    Code code = annotate(MethodContext{analyses.class_, analyses.get<Disassembly>(), analyses.is_static()}, output, analyses.symbols);
+    output << code.to_string();
+    output << "    }" << std::endl;
+
+    output << "    >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>" << std::endl;
+    write_code_flow(output, analyses.get<Flow>());
+    output << "    <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<" << std::endl;
+    return output.str();
+}
+
+}
+
+}
+
+#endif // JJDE_PASSES_HPP
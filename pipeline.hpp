@@ -0,0 +1,241 @@
+#ifndef JJDE_PIPELINE_HPP
+#define JJDE_PIPELINE_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "class.hpp"
+#include "corpus.hpp"
+#include "parallel.hpp"
+
+namespace jjde {
+
+/* Streaming pipeline
+ *
+ * Processes a corpus in four stages that run concurrently:
+ *
+ *     read (1 thread) -> parse (workers) -> render (workers) -> write (calling thread, in corpus order)
+ *
+ * Consecutive stages are connected by bounded queues. In addition, every class is charged against a
+ * memory budget from the moment it is read until its output has been written; the reader blocks while
+ * the budget is exhausted, so the amount of memory in flight (class file bytes, parsed classes, output
+ * waiting to be written in order) stays bounded no matter how large the corpus is. Each class is freed
+ * as soon as it has been rendered, and its output as soon as it has been written.
+ *
+ * The charge of a class is estimated from the size of its class file when it is read and corrected
+ * once its output is known. A single class that is larger than the whole budget is still processed,
+ * but only while nothing else is in flight.
+ */
+
+class MemoryBudget {
+public:
+    explicit MemoryBudget(uint64_t limit_) : limit(limit_) {}
+
+    // Blocks until the amount is available
+    void acquire(uint64_t amount) {
+        std::unique_lock<std::mutex> lock(mutex);
+        available.wait(lock, [&]() { return used == 0 || used + amount <= limit; });
+        used += amount;
+    }
+
+    // Never blocks (for corrections of earlier estimates), so it cannot deadlock the pipeline
+    void adjust(uint64_t old_amount, uint64_t new_amount) {
+        std::lock_guard<std::mutex> lock(mutex);
+        used = used - old_amount + new_amount;
+        if (new_amount < old_amount) available.notify_all();
+    }
+
+    void release(uint64_t amount) {
+        adjust(amount, 0);
+    }
+
+    uint64_t in_use() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return used;
+    }
+
+private:
+    uint64_t limit;
+    uint64_t used = 0;
+    mutable std::mutex mutex;
+    std::condition_variable available;
+};
+
+template <typename T>
+class BoundedQueue {
+public:
+    BoundedQueue(std::size_t capacity_, std::size_t producers_)
+        : capacity(std::max<std::size_t>(capacity_, 1))
+        , producers(producers_) {}
+
+    // Blocks while the queue is full
+    void push(T value) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [&]() { return items.size() < capacity; });
+        items.push_back(std::move(value));
+        not_empty.notify_one();
+    }
+
+    // Blocks until an item is available. Returns false once all producers are done and the queue is empty.
+    bool pop(T & value) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [&]() { return !items.empty() || producers == 0; });
+        if (items.empty()) return false;
+        value = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    // Called once by every producer when it has pushed its last item
+    void producer_done() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--producers == 0) not_empty.notify_all();
+    }
+
+private:
+    std::size_t capacity;
+    std::size_t producers;
+    std::deque<T> items;
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+};
+
+struct PipelineOptions {
+    std::size_t threads = default_thread_count();
+    uint64_t memory_budget = 256ull << 20;
+    std::size_t queue_capacity = 64;
+};
+
+struct PipelineItem {
+    std::size_t entry;                // In the corpus
+    std::vector<unsigned char> bytes; // Class file (freed after parsing)
+    std::unique_ptr<Class> class_;    // Parsed class (freed after rendering)
+    std::string output;               // Rendered output (freed after writing)
+    bool rendered = false;            // Set by a stage that produces the output directly
+    std::string error;                // Set if a stage failed; later stages are skipped
+    uint64_t charge = 0;              // Against the memory budget
+};
+
+class Pipeline {
+public:
+    // parse: bytes -> class_ (or output, for example from a cache, with rendered = true)
+    // render: class_ -> output
+    // write: called in corpus order
+    typedef std::function<void(PipelineItem &)> Stage;
+    typedef std::function<void(PipelineItem const&)> Writer;
+
+    Pipeline(Corpus const& corpus_, PipelineOptions const& options_)
+        : corpus(corpus_)
+        , options(options_)
+        , budget(options_.memory_budget) {}
+
+    void run(Stage parse, Stage render, Writer write) {
+        std::size_t workers = std::max<std::size_t>(1, options.threads);
+        std::size_t parsers = std::max<std::size_t>(1, workers / 4);
+        BoundedQueue<std::unique_ptr<PipelineItem>> read_queue(options.queue_capacity, 1);
+        BoundedQueue<std::unique_ptr<PipelineItem>> parse_queue(options.queue_capacity, parsers);
+        BoundedQueue<std::unique_ptr<PipelineItem>> render_queue(options.queue_capacity, workers);
+
+        std::vector<std::thread> threads;
+        threads.emplace_back([&]() {
+            for (std::size_t index = 0; index < corpus.size(); ++index) {
+                std::unique_ptr<PipelineItem> item(new PipelineItem());
+                item->entry = index;
+                // Backpressure: wait until earlier classes have been written
+                item->charge = estimate(corpus[index]);
+                budget.acquire(item->charge);
+                guarded(*item, [&](PipelineItem & item) { item.bytes = corpus.read(item.entry); });
+                read_queue.push(std::move(item));
+            }
+            read_queue.producer_done();
+        });
+        for (std::size_t parser = 0; parser < parsers; ++parser) {
+            threads.emplace_back([&]() {
+                for (std::unique_ptr<PipelineItem> item; read_queue.pop(item);) {
+                    if (item->error.empty()) guarded(*item, parse);
+                    std::vector<unsigned char>().swap(item->bytes);
+                    parse_queue.push(std::move(item));
+                }
+                parse_queue.producer_done();
+            });
+        }
+        for (std::size_t worker = 0; worker < workers; ++worker) {
+            threads.emplace_back([&]() {
+                for (std::unique_ptr<PipelineItem> item; parse_queue.pop(item);) {
+                    if (item->error.empty() && !item->rendered) guarded(*item, render);
+                    item->class_.reset();
+                    // The output is held until it is written
+                    uint64_t charge = item->output.size() + sizeof(PipelineItem);
+                    budget.adjust(item->charge, charge);
+                    item->charge = charge;
+                    render_queue.push(std::move(item));
+                }
+                render_queue.producer_done();
+            });
+        }
+
+        // Write in corpus order; classes that finish early wait (charged against the budget) in pending
+        std::map<std::size_t, std::unique_ptr<PipelineItem>> pending;
+        std::size_t next = 0;
+        std::exception_ptr error;
+        for (std::unique_ptr<PipelineItem> item; render_queue.pop(item);) {
+            pending.emplace(item->entry, std::move(item));
+            for (auto it = pending.find(next); it != pending.end(); it = pending.find(++next)) {
+                if (!error) {
+                    try {
+                        write(*it->second);
+                    } catch (...) {
+                        error = std::current_exception(); // Keep draining, so that the other threads can finish
+                    }
+                }
+                budget.release(it->second->charge);
+                pending.erase(it);
+            }
+        }
+        for (std::thread & thread : threads) thread.join();
+        if (error) std::rethrow_exception(error);
+    }
+
+private:
+    Corpus const& corpus;
+    PipelineOptions options;
+    MemoryBudget budget;
+
+    // Class file, parsed class and output (the output is usually a few times larger than the class file)
+    static uint64_t estimate(CorpusEntry const& entry) {
+        uint64_t size = entry.size;
+        if (entry.archive.empty()) {
+            std::error_code error;
+            size = std::filesystem::file_size(entry.name, error);
+            if (error) size = 0;
+        }
+        return sizeof(PipelineItem) + 8 * size;
+    }
+
+    template <typename Function>
+    static void guarded(PipelineItem & item, Function const& function) {
+        try {
+            function(item);
+        } catch (std::exception const& error) {
+            item.error = error.what();
+        }
+    }
+};
+
+}
+
+#endif // JJDE_PIPELINE_HPP
@@ -0,0 +1,213 @@
+#ifndef JJDE_SEARCH_HPP
+#define JJDE_SEARCH_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "constants.hpp"
+#include "corpus.hpp"
+
+namespace jjde {
+
+/* Constant pool string search
+ *
+ * Finds the classes whose constant pool contains one of a set of substrings. Only the constant pool is
+ * walked, straight from the bytes of the class file: nothing after it (flags, fields, methods or
+ * attributes) is looked at, and no Constant objects or strings are created except for matches.
+ *
+ * Patterns are matched against the raw (modified UTF-8) bytes of the STRING entries, which is the same
+ * as matching the decoded string for ASCII patterns.
+ */
+
+namespace detail {
+
+inline bool find_scalar(unsigned char const* haystack, std::size_t size, std::string_view needle) {
+    if (needle.size() > size) return false;
+    unsigned char const* first = reinterpret_cast<unsigned char const*>(needle.data());
+    for (std::size_t position = 0; position + needle.size() <= size; ++position) {
+        if (haystack[position] == first[0] && std::memcmp(haystack + position, first, needle.size()) == 0) return true;
+    }
+    return false;
+}
+
+// Substring search; with SSE2, 16 candidate positions are filtered at once by comparing the first and
+// the last byte of the needle, and only positions where both match are compared in full.
+inline bool find(unsigned char const* haystack, std::size_t size, std::string_view needle) {
+    if (needle.empty()) return true;
+    if (needle.size() > size) return false;
+    if (needle.size() == 1) return std::memchr(haystack, needle[0], size) != nullptr;
+#ifdef __SSE2__
+    std::size_t last = needle.size() - 1;
+    __m128i first_byte = _mm_set1_epi8(needle[0]);
+    __m128i last_byte = _mm_set1_epi8(needle[last]);
+    std::size_t position = 0;
+    for (; position + last + 16 <= size; position += 16) {
+        __m128i block_first = _mm_loadu_si128(reinterpret_cast<__m128i const*>(haystack + position));
+        __m128i block_last = _mm_loadu_si128(reinterpret_cast<__m128i const*>(haystack + position + last));
+        unsigned mask = (unsigned) _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first_byte), _mm_cmpeq_epi8(block_last, last_byte)));
+        while (mask != 0) {
+            unsigned bit = (unsigned) __builtin_ctz(mask);
+            if (std::memcmp(haystack + position + bit + 1, needle.data() + 1, last - 1) == 0) return true;
+            mask &= mask - 1;
+        }
+    }
+    return find_scalar(haystack + position, size - position, needle);
+#else
+    return find_scalar(haystack, size, needle);
+#endif
+}
+
+inline uint16_t big_u16(unsigned char const* data) {
+    return (uint16_t) ((data[0] << 8) | data[1]);
+}
+
+// Size of a constant pool entry (including its tag), or 0 for unknown tags
+inline std::size_t constant_size(unsigned char const* entry, unsigned char const* end) {
+    switch (entry[0]) {
+    case Constant::STRING:
+        return (end - entry >= 3) ? 3 + big_u16(entry + 1) : 0;
+    case Constant::INTEGER:
+    case Constant::FLOAT:
+    case Constant::FIELD_REFERENCE:
+    case Constant::METHOD_REFERENCE:
+    case Constant::INTERFACE_METHOD_REFERENCE:
+    case Constant::NAME_TYPE_DESCRIPTOR:
+    case Constant::INVOKE_DYNAMIC:
+        return 5;
+    case Constant::LONG:
+    case Constant::DOUBLE:
+        return 9;
+    case Constant::CLASS_REFERENCE:
+    case Constant::STRING_REFERENCE:
+    case Constant::METHOD_TYPE:
+        return 3;
+    case Constant::METHOD_HANDLE:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+}
+
+struct SearchMatch {
+    std::size_t entry;   // In the corpus
+    std::string class_name;
+    std::string string;  // Matching constant
+};
+
+/* Scanning a single class
+ *
+ * A ConstantPoolSearch may be reused for any number of classes (but not concurrently); it keeps its
+ * scratch buffers between classes. Copies have scratch buffers of their own.
+ */
+
+class ConstantPoolSearch {
+public:
+    // If literals_only is set, only strings that are used as string literals (CONSTANT_String) match.
+    // The patterns must outlive the searcher.
+    ConstantPoolSearch(std::vector<std::string> const& patterns_, bool literals_only_)
+        : patterns(patterns_)
+        , literals_only(literals_only_) {}
+
+    // Appends one match per matching constant. Returns false if the data is not a valid class file.
+    bool scan(unsigned char const* data, std::size_t size, std::size_t entry, std::vector<SearchMatch> & matches) {
+        unsigned char const* end = data + size;
+        if (size < 10 || data[0] != 0xCA || data[1] != 0xFE || data[2] != 0xBA || data[3] != 0xBE) return false;
+        uint16_t count = detail::big_u16(data + 8);
+
+        offsets.assign(count, 0);
+        matched.clear();
+        literals.clear();
+        unsigned char const* position = data + 10;
+        for (uint16_t index = 1; index < count; ++index) {
+            if (position >= end) return false;
+            std::size_t length = detail::constant_size(position, end);
+            if (length == 0 || (std::size_t) (end - position) < length) return false;
+            offsets[index] = (uint32_t) (position - data);
+
+            if (position[0] == Constant::STRING) {
+                for (std::string const& pattern : patterns) {
+                    if (detail::find(position + 3, length - 3, pattern)) {
+                        matched.push_back(index);
+                        break;
+                    }
+                }
+            } else if (position[0] == Constant::STRING_REFERENCE) {
+                literals.push_back(detail::big_u16(position + 1));
+            } else if (position[0] == Constant::LONG || position[0] == Constant::DOUBLE) {
+                ++index; // Takes two slots
+            }
+            position += length;
+        }
+        if (matched.empty()) return true;
+
+        if (literals_only) {
+            std::sort(literals.begin(), literals.end());
+            matched.erase(std::remove_if(matched.begin(), matched.end(), [this](uint16_t index) {
+                return !std::binary_search(literals.begin(), literals.end(), index);
+            }), matched.end());
+            if (matched.empty()) return true;
+        }
+
+        // The name of the class follows the access flags, right after the pool
+        std::string class_name;
+        if (end - position >= 4) {
+            uint16_t class_index = detail::big_u16(position + 2);
+            if (class_index < count && offsets[class_index] != 0 && data[offsets[class_index]] == Constant::CLASS_REFERENCE) {
+                uint16_t name_index = detail::big_u16(data + offsets[class_index] + 1);
+                if (name_index < count && offsets[name_index] != 0 && data[offsets[name_index]] == Constant::STRING) {
+                    class_name = string_at(data, offsets[name_index]);
+                    std::replace(class_name.begin(), class_name.end(), '/', '.');
+                }
+            }
+        }
+        for (uint16_t index : matched) {
+            matches.push_back(SearchMatch{entry, class_name, string_at(data, offsets[index])});
+        }
+        return true;
+    }
+
+private:
+    std::vector<std::string> const& patterns;
+    bool literals_only;
+
+    // Scratch space (reused between classes)
+    std::vector<uint32_t> offsets; // Offset of each pool entry in the class file
+    std::vector<uint16_t> matched;
+    std::vector<uint16_t> literals; // Targets of CONSTANT_String entries
+
+    static std::string string_at(unsigned char const* data, uint32_t offset) {
+        return convert_java_string(std::vector<unsigned char>(data + offset + 3, data + offset + 3 + detail::big_u16(data + offset + 1)));
+    }
+};
+
+// Search all classes of a corpus (in parallel); matches are ordered by corpus entry.
+std::vector<SearchMatch> search_corpus(Corpus const& corpus, std::vector<std::string> const& patterns, bool literals_only) {
+    // One searcher (and its scratch buffers) per block of 64 classes
+    auto scan = [search = ConstantPoolSearch(patterns, literals_only)](std::vector<unsigned char> const& data, std::size_t entry) mutable {
+        std::vector<SearchMatch> matches;
+        if (!search.scan(data.data(), data.size(), entry, matches)) throw std::runtime_error("not a valid class file");
+        return matches;
+    };
+
+    std::vector<SearchMatch> matches;
+    for (auto & result : read_corpus(corpus, scan, 64)) {
+        std::move(result.second.begin(), result.second.end(), std::back_inserter(matches));
+    }
+    return matches;
+}
+
+}
+
+#endif // JJDE_SEARCH_HPP
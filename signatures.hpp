@@ -0,0 +1,329 @@
+#ifndef JJDE_SIGNATURES_HPP
+#define JJDE_SIGNATURES_HPP
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace jjde {
+
+/* Signature syntax trees
+ *
+ * Nodes are allocated from a SignatureArena and are freed together with it. Names and source spans
+ * are views into the parsed signature, which must outlive the nodes (usually, it is a string in the
+ * constant pool).
+ *
+ * Lists (type arguments, type parameters, bounds, method arguments, exceptions) are singly linked
+ * through `next`.
+ */
+
+struct SignatureNode {
+    enum Kind : uint8_t {
+        BASE,            // indicator: B, C, D, F, I, J, S, Z or V
+        CLASS,           // name: binary name (with '/'), arguments: type arguments, element: outer class (for '.' suffixes)
+        TYPE_VARIABLE,   // name: identifier
+        ARRAY,           // element: component type
+        WILDCARD,        // indicator: '+', '-' or '*', element: bound (not for '*')
+        TYPE_PARAMETER,  // name: identifier, arguments: bounds (element: class bound, if present)
+        METHOD,          // parameters: type parameters, arguments: argument types, element: result, exceptions: throws
+        CLASS_SIGNATURE  // parameters: type parameters, element: superclass, arguments: superinterfaces
+    };
+
+    Kind kind;
+    char indicator = '\0';
+    std::string_view name;
+    std::string_view text; // The part of the signature this node was parsed from
+    SignatureNode const* element = nullptr;
+    SignatureNode const* arguments = nullptr;
+    SignatureNode const* parameters = nullptr;
+    SignatureNode const* exceptions = nullptr;
+    SignatureNode const* next = nullptr;
+};
+
+/* Arena for signature nodes (nodes are never freed individually) */
+
+class SignatureArena {
+public:
+    SignatureArena() = default;
+    SignatureArena(SignatureArena const&) = delete;
+    SignatureArena & operator=(SignatureArena const&) = delete;
+
+    SignatureNode * make(SignatureNode::Kind kind) {
+        if (blocks.empty() || used == block_size) {
+            if (current + 1 < blocks.size()) {
+                ++current;
+            } else {
+                blocks.emplace_back(new SignatureNode[block_size]);
+                current = blocks.size() - 1;
+            }
+            used = 0;
+        }
+        SignatureNode * node = &blocks[current][used++];
+        *node = SignatureNode();
+        node->kind = kind;
+        return node;
+    }
+
+    // Invalidate all nodes, but keep the memory for reuse
+    void clear() {
+        current = 0;
+        used = 0;
+    }
+
+private:
+    static constexpr std::size_t block_size = 64;
+    std::vector<std::unique_ptr<SignatureNode[]>> blocks;
+    std::size_t current = 0;
+    std::size_t used = 0;
+};
+
+/* Recursive descent parser for descriptors and signatures (JVMS §4.3, §4.7.9.1)
+ *
+ * Every character of the input is looked at exactly once. Descriptors are a subset of the signature
+ * grammar, so both can be parsed with the same functions.
+ */
+
+class SignatureParser {
+public:
+    SignatureParser(std::string_view signature, SignatureArena & arena_)
+        : input(signature)
+        , arena(arena_) {}
+
+    // Field descriptor or signature (JavaTypeSignature); also accepts V, for return types.
+    SignatureNode const* parse_type() {
+        SignatureNode const* node = java_type(true);
+        finish();
+        return node;
+    }
+
+    // A sequence of types (for example, the contents of a method descriptor's parentheses)
+    SignatureNode const* parse_types() {
+        SignatureNode const* first = nullptr;
+        SignatureNode const** tail = &first;
+        while (position < input.size()) {
+            SignatureNode * node = java_type(true);
+            *tail = node;
+            tail = &node->next;
+        }
+        return first;
+    }
+
+    // [TypeParameters] ( {JavaTypeSignature} ) Result {ThrowsSignature}
+    SignatureNode const* parse_method() {
+        std::size_t start = position;
+        SignatureNode * method = arena.make(SignatureNode::METHOD);
+        if (peek() == '<') method->parameters = type_parameters();
+        expect('(');
+        SignatureNode const** tail = &method->arguments;
+        while (peek() != ')') {
+            SignatureNode * argument = java_type(false);
+            *tail = argument;
+            tail = &argument->next;
+        }
+        expect(')');
+        method->element = java_type(true);
+        tail = &method->exceptions;
+        while (position < input.size() && peek() == '^') {
+            ++position;
+            SignatureNode * exception = (peek() == 'T') ? type_variable() : class_type();
+            *tail = exception;
+            tail = &exception->next;
+        }
+        method->text = input.substr(start, position - start);
+        finish();
+        return method;
+    }
+
+    // [TypeParameters] SuperclassSignature {SuperinterfaceSignature}
+    SignatureNode const* parse_class() {
+        SignatureNode * signature = arena.make(SignatureNode::CLASS_SIGNATURE);
+        if (peek() == '<') signature->parameters = type_parameters();
+        signature->element = class_type();
+        SignatureNode const** tail = &signature->arguments;
+        while (position < input.size()) {
+            SignatureNode * interface = class_type();
+            *tail = interface;
+            tail = &interface->next;
+        }
+        signature->text = input;
+        return signature;
+    }
+
+private:
+    std::string_view input;
+    std::size_t position = 0;
+    SignatureArena & arena;
+
+    [[noreturn]] void fail(char const* reason) const {
+        throw std::logic_error("Malformed type: " + std::string(input) + " (" + reason + " at position " + std::to_string(position) + ")");
+    }
+
+    char peek() const {
+        if (position >= input.size()) fail("unexpected end");
+        return input[position];
+    }
+
+    void expect(char c) {
+        if (peek() != c) fail("unexpected character");
+        ++position;
+    }
+
+    void finish() const {
+        if (position != input.size()) fail("trailing characters");
+    }
+
+    // Identifiers end at any of . ; [ / < > : (JVMS §4.2.2). Class names may contain '/'.
+    std::string_view identifier(bool allow_slash) {
+        std::size_t start = position;
+        while (position < input.size()) {
+            char c = input[position];
+            if (c == '.' || c == ';' || c == '[' || c == '<' || c == '>' || c == ':' || (c == '/' && !allow_slash)) break;
+            ++position;
+        }
+        if (position == start) fail("empty identifier");
+        return input.substr(start, position - start);
+    }
+
+    SignatureNode * java_type(bool allow_void) {
+        std::size_t start = position;
+        char c = peek();
+        SignatureNode * node;
+        switch (c) {
+        case 'V':
+            if (!allow_void) fail("void is not a valid type here");
+            // fall through
+        case 'B':
+        case 'C':
+        case 'D':
+        case 'F':
+        case 'I':
+        case 'J':
+        case 'S':
+        case 'Z':
+            ++position;
+            node = arena.make(SignatureNode::BASE);
+            node->indicator = c;
+            node->text = input.substr(start, 1);
+            return node;
+        default:
+            return reference_type();
+        }
+    }
+
+    SignatureNode * reference_type() {
+        std::size_t start = position;
+        SignatureNode * node;
+        switch (peek()) {
+        case 'L':
+            return class_type();
+        case 'T':
+            return type_variable();
+        case '[':
+            ++position;
+            node = arena.make(SignatureNode::ARRAY);
+            node->element = java_type(false);
+            node->text = input.substr(start, position - start);
+            return node;
+        default:
+            fail("invalid type specifier");
+        }
+    }
+
+    // T Identifier ;
+    SignatureNode * type_variable() {
+        std::size_t start = position;
+        expect('T');
+        SignatureNode * node = arena.make(SignatureNode::TYPE_VARIABLE);
+        node->name = identifier(false);
+        expect(';');
+        node->text = input.substr(start, position - start);
+        return node;
+    }
+
+    // L [PackageSpecifier] SimpleClassTypeSignature {. SimpleClassTypeSignature} ;
+    SignatureNode * class_type() {
+        std::size_t start = position;
+        expect('L');
+        SignatureNode * node = arena.make(SignatureNode::CLASS);
+        node->name = identifier(true);
+        if (peek() == '<') node->arguments = type_arguments();
+        while (peek() == '.') {
+            ++position;
+            SignatureNode * inner = arena.make(SignatureNode::CLASS);
+            inner->element = node;
+            inner->name = identifier(false);
+            if (peek() == '<') inner->arguments = type_arguments();
+            node->text = input.substr(start, position - start);
+            node = inner;
+        }
+        expect(';');
+        node->text = input.substr(start, position - start);
+        return node;
+    }
+
+    // < TypeArgument {TypeArgument} >
+    SignatureNode const* type_arguments() {
+        expect('<');
+        SignatureNode const* first = nullptr;
+        SignatureNode const** tail = &first;
+        do {
+            std::size_t start = position;
+            SignatureNode * argument;
+            char c = peek();
+            if (c == '*' || c == '+' || c == '-') {
+                ++position;
+                argument = arena.make(SignatureNode::WILDCARD);
+                argument->indicator = c;
+                if (c != '*') argument->element = reference_type();
+                argument->text = input.substr(start, position - start);
+            } else {
+                argument = reference_type();
+            }
+            *tail = argument;
+            tail = &argument->next;
+        } while (peek() != '>');
+        ++position;
+        return first;
+    }
+
+    // < Identifier : [ReferenceTypeSignature] {: ReferenceTypeSignature} ... >
+    SignatureNode const* type_parameters() {
+        expect('<');
+        SignatureNode const* first = nullptr;
+        SignatureNode const** tail = &first;
+        do {
+            std::size_t start = position;
+            SignatureNode * parameter = arena.make(SignatureNode::TYPE_PARAMETER);
+            parameter->name = identifier(false);
+            SignatureNode const** bound_tail = &parameter->arguments;
+            // Class bound (may be empty, if there are interface bounds)
+            expect(':');
+            char c = peek();
+            if (c == 'L' || c == 'T' || c == '[') {
+                SignatureNode * bound = reference_type();
+                parameter->element = bound;
+                *bound_tail = bound;
+                bound_tail = &bound->next;
+            }
+            // Interface bounds
+            while (peek() == ':') {
+                ++position;
+                SignatureNode * bound = reference_type();
+                *bound_tail = bound;
+                bound_tail = &bound->next;
+            }
+            parameter->text = input.substr(start, position - start);
+            *tail = parameter;
+            tail = &parameter->next;
+        } while (peek() != '>');
+        ++position;
+        return first;
+    }
+};
+
+}
+
+#endif // JJDE_SIGNATURES_HPP
@@ -4,29 +4,110 @@
 #include "bytes.hpp"
 #include "class.hpp"
 #include "constants.hpp"
+#include "context.hpp"
 #include "disassembler.hpp"
+#include "expressions.hpp"
 #include "instructions.hpp"
-
-#include <deque>
+#include "stack.hpp"
 
 namespace jjde {
 
 struct Simulation {
-    std::deque<std::string> stack;
+    OperandStack<Expression const*> stack;
+    ExpressionPool expressions;
 
     Class const& class_;
     bool static_;
 
-    Simulation(Class const& the_class, Bytecode const& bytecode, bool is_static)
-        : stack(bytecode.max_stack_size)
-        , class_(the_class)
-        , static_(is_static) {}
+    explicit Simulation(MethodContext const& context)
+        : stack(context.bytecode.max_stack_size)
+        , class_(context.class_)
+        , static_(context.static_) {}
+
+    // Start simulating another method of the same class (keeps the stack buffers)
+    void reset(MethodContext const& context) {
+        if (&context.class_ != &class_) throw std::logic_error("Simulation reset with a method of another class");
+        stack.reset(context.bytecode.max_stack_size);
+        expressions.clear();
+        static_ = context.static_;
+    }
 
     std::string str;
 
-    void load_constant(uint16_t index) {
-        std::string tmp;
+    // Stack slot kind of the value produced by typed load, array load and arithmetic instructions
+    static StackSlot::Kind value_kind(Instruction::Operation operation) {
+        switch (operation) {
+        case Instruction::ILOAD: case Instruction::ILOAD_0: case Instruction::ILOAD_1: case Instruction::ILOAD_2: case Instruction::ILOAD_3:
+        case Instruction::IALOAD: case Instruction::BALOAD: case Instruction::CALOAD: case Instruction::SALOAD:
+            return StackSlot::INTEGER;
+        case Instruction::LLOAD: case Instruction::LLOAD_0: case Instruction::LLOAD_1: case Instruction::LLOAD_2: case Instruction::LLOAD_3:
+        case Instruction::LALOAD:
+            return StackSlot::LONG;
+        case Instruction::FLOAD: case Instruction::FLOAD_0: case Instruction::FLOAD_1: case Instruction::FLOAD_2: case Instruction::FLOAD_3:
+        case Instruction::FALOAD:
+            return StackSlot::FLOAT;
+        case Instruction::DLOAD: case Instruction::DLOAD_0: case Instruction::DLOAD_1: case Instruction::DLOAD_2: case Instruction::DLOAD_3:
+        case Instruction::DALOAD:
+            return StackSlot::DOUBLE;
+        case Instruction::ALOAD: case Instruction::ALOAD_0: case Instruction::ALOAD_1: case Instruction::ALOAD_2: case Instruction::ALOAD_3:
+        case Instruction::AALOAD:
+            return StackSlot::REFERENCE;
+        default:
+            break;
+        }
+        if (Instruction::IADD <= operation && operation <= Instruction::DNEG) {
+            // IADD, LADD, FADD, DADD, ISUB, ... are ordered by type
+            static const StackSlot::Kind kinds[] = { StackSlot::INTEGER, StackSlot::LONG, StackSlot::FLOAT, StackSlot::DOUBLE };
+            return kinds[(operation - Instruction::IADD) % 4];
+        }
+        if (Instruction::ISHL <= operation && operation <= Instruction::LXOR) {
+            // ISHL, LSHL, ISHR, ... alternate between int and long
+            return ((operation - Instruction::ISHL) % 2 == 0) ? StackSlot::INTEGER : StackSlot::LONG;
+        }
+        throw std::logic_error("No value kind for opcode " + Instruction::name[operation]);
+    }
+
+    // Stack slot kind of a field value, from the first character of its descriptor
+    static StackSlot::Kind descriptor_kind(std::string const& descriptor) {
+        switch (descriptor.empty() ? 'L' : descriptor[0]) {
+        case 'J': return StackSlot::LONG;
+        case 'D': return StackSlot::DOUBLE;
+        case 'F': return StackSlot::FLOAT;
+        case 'L':
+        case '[': return StackSlot::REFERENCE;
+        default:  return StackSlot::INTEGER;
+        }
+    }
 
+    void binary_operation(std::string const& op, StackSlot::Kind kind) {
+        Expression const* rhs = stack.pop();
+        Expression const* lhs = stack.pop();
+        stack.push(expressions.binary(op, lhs, rhs, kind), kind);
+    }
+
+    void store(uint16_t index) {
+        std::cout << "var" << index << " = " << stack.pop()->to_string() << std::endl;
+        expressions.store_local(index);
+    }
+
+    void load_field(uint16_t index, bool is_static) {
+        Constant const& reference = class_.constants.at(index);
+        if (reference.type != Constant::FIELD_REFERENCE) {
+            throw std::logic_error("Invalid constant pool data type.");
+        }
+        Constant const& name_type = class_.constants.at(reference.value.pair_reference.second);
+        std::string const& name = class_.constants.at(name_type.value.pair_reference.first).value.string;
+        StackSlot::Kind kind = descriptor_kind(class_.constants.at(name_type.value.pair_reference.second).value.string);
+        if (is_static) {
+            std::string const& owner = class_.constant(reference.value.pair_reference.first);
+            stack.push(expressions.field(nullptr, owner + "." + name), kind);
+        } else {
+            Expression const* object = stack.pop_category_1();
+            stack.push(expressions.field(object, name), kind);
+        }
+    }
+
+    void load_constant(uint16_t index) {
         if (index >= class_.constants.size()) {
             std::cerr << "Constant pool entry " << index << " requested, but only " << (class_.constants.size() - 1) << " entries are available." << std::endl;
             throw std::logic_error("Invalid constant pool index.");
@@ -38,35 +119,32 @@ struct Simulation {
             throw std::logic_error("Invalid constant pool data type.");
         case Constant::STRING:
         case Constant::STRING_REFERENCE:
-        case Constant::INTEGER:
             // No additional markers
-            stack.push_back(class_.constants[index].to_string(class_.constants));
+            stack.push(expressions.literal(class_.constant(index)), StackSlot::REFERENCE);
+            break;
+        case Constant::INTEGER:
+            stack.push(expressions.integer(class_.constants[index].value.integer), StackSlot::INTEGER);
             break;
         case Constant::FLOAT:
             // "f" marker
-            stack.push_back(class_.constants[index].to_string(class_.constants) + "f");
+            stack.push(expressions.literal(class_.constant(index) + "f"), StackSlot::FLOAT);
             break;
         case Constant::LONG:
-            // LONG and DOUBLE use two stack spaces
-            tmp = class_.constants[index].to_string(class_.constants) + "L";
-            stack.push_back(tmp);
-            stack.push_back(tmp);
+            // LONG and DOUBLE use two stack slots (handled by the stack)
+            stack.push(expressions.long_(class_.constants[index].value.long_), StackSlot::LONG);
             break;
         case Constant::DOUBLE:
-            // LONG and DOUBLE use two stack spaces
-            tmp = class_.constants[index].to_string(class_.constants);
-            stack.push_back(tmp);
-            stack.push_back(tmp);
+            stack.push(expressions.literal(class_.constant(index)), StackSlot::DOUBLE);
             break;
         case Constant::CLASS_REFERENCE:
-            stack.push_back(std::string("Class<") + class_.constants[index].to_string(class_.constants) + ">");
+            stack.push(expressions.literal(std::string("Class<") + class_.constant(index) + ">"), StackSlot::REFERENCE);
             break;
         // Constant::STRING_REFERENCE handled with Constant::STRING
         case Constant::METHOD_HANDLE:
-            stack.push_back("java.lang.invoke.MethodHandle");
+            stack.push(expressions.literal("java.lang.invoke.MethodHandle"), StackSlot::REFERENCE);
             break;
         case Constant::METHOD_TYPE:
-            stack.push_back("java.lang.invoke.MethodType");
+            stack.push(expressions.literal("java.lang.invoke.MethodType"), StackSlot::REFERENCE);
             break;
         case Constant::FIELD_REFERENCE:
         case Constant::METHOD_REFERENCE:
@@ -83,62 +161,48 @@ struct Simulation {
     void process(Instruction const& instruction) {
         uint16_t index;
         int64_t signed_value;
-        std::string expr;
-        std::size_t previous;
-        std::string tmp;
+        Expression const* expr;
 
         switch (instruction.operation) {
         case Instruction::NOP: break;
         case Instruction::ACONST_NULL:
-            stack.push_back("null");
+            stack.push(expressions.literal("null"), StackSlot::REFERENCE);
             break;
         case Instruction::ICONST_M1:
-            stack.push_back("-1");
-            break;
         case Instruction::ICONST_0:
-            stack.push_back("0");
-            break;
         case Instruction::ICONST_1:
-            stack.push_back("1");
-            break;
         case Instruction::ICONST_2:
-            stack.push_back("2");
-            break;
         case Instruction::ICONST_3:
-            stack.push_back("3");
-            break;
         case Instruction::ICONST_4:
-            stack.push_back("4");
-            break;
         case Instruction::ICONST_5:
-            stack.push_back("5");
+            stack.push(expressions.integer((int) instruction.operation - (int) Instruction::ICONST_0), StackSlot::INTEGER);
             break;
         case Instruction::LCONST_0:
-            stack.push_back("0L");
+            stack.push(expressions.long_(0), StackSlot::LONG);
             break;
         case Instruction::LCONST_1:
-            stack.push_back("1L");
+            stack.push(expressions.long_(1), StackSlot::LONG);
             break;
         case Instruction::FCONST_0:
-            stack.push_back("0.0f");
+            stack.push(expressions.literal("0.0f"), StackSlot::FLOAT);
             break;
         case Instruction::FCONST_1:
-            stack.push_back("1.0f");
+            stack.push(expressions.literal("1.0f"), StackSlot::FLOAT);
             break;
         case Instruction::FCONST_2:
-            stack.push_back("2.0f");
+            stack.push(expressions.literal("2.0f"), StackSlot::FLOAT);
             break;
         case Instruction::DCONST_0:
-            stack.push_back("0.0");
+            stack.push(expressions.literal("0.0"), StackSlot::DOUBLE);
             break;
         case Instruction::DCONST_1:
-            stack.push_back("1.0");
+            stack.push(expressions.literal("1.0"), StackSlot::DOUBLE);
             break;
         case Instruction::BIPUSH:
-            stack.push_back(std::to_string(parse<int8_t>(convert<1>(instruction.arguments))));
+            stack.push(expressions.integer(parse<int8_t>(convert<1>(instruction.arguments))), StackSlot::INTEGER);
             break;
         case Instruction::SIPUSH:
-            stack.push_back(std::to_string(parse<int16_t>(convert<2>(instruction.arguments))));
+            stack.push(expressions.integer(parse<int16_t>(convert<2>(instruction.arguments))), StackSlot::INTEGER);
             break;
         case Instruction::LDC:
             index = parse<uint8_t>(convert<1>(instruction.arguments));
@@ -155,35 +219,35 @@ struct Simulation {
         case Instruction::DLOAD:
         case Instruction::ALOAD:
             index = parse<uint8_t>(convert<1>(instruction.arguments));
-            stack.push_back("var" + std::to_string(index));
+            stack.push(expressions.local(index), value_kind(instruction.operation));
             break;
         case Instruction::ILOAD_0:
         case Instruction::LLOAD_0:
         case Instruction::FLOAD_0:
         case Instruction::DLOAD_0:
         case Instruction::ALOAD_0:
-            stack.push_back("var0");
+            stack.push(expressions.local(0), value_kind(instruction.operation));
             break;
         case Instruction::ILOAD_1:
         case Instruction::LLOAD_1:
         case Instruction::FLOAD_1:
         case Instruction::DLOAD_1:
         case Instruction::ALOAD_1:
-            stack.push_back("var1");
+            stack.push(expressions.local(1), value_kind(instruction.operation));
             break;
         case Instruction::ILOAD_2:
         case Instruction::LLOAD_2:
         case Instruction::FLOAD_2:
         case Instruction::DLOAD_2:
         case Instruction::ALOAD_2:
-            stack.push_back("var2");
+            stack.push(expressions.local(2), value_kind(instruction.operation));
             break;
         case Instruction::ILOAD_3:
         case Instruction::LLOAD_3:
         case Instruction::FLOAD_3:
         case Instruction::DLOAD_3:
         case Instruction::ALOAD_3:
-            stack.push_back("var3");
+            stack.push(expressions.local(3), value_kind(instruction.operation));
             break;
         case Instruction::IALOAD:
         case Instruction::LALOAD:
@@ -193,9 +257,8 @@ struct Simulation {
         case Instruction::BALOAD:
         case Instruction::CALOAD:
         case Instruction::SALOAD:
-            expr = stack[stack.size() - 2] + "[" + stack[stack.size() - 1] + "]";
-            stack.resize(stack.size() - 2);
-            stack.push_back(expr);
+            expr = stack.pop();
+            stack.push(expressions.array_element(stack.pop(), expr), value_kind(instruction.operation));
             break;
         case Instruction::ISTORE:
         case Instruction::LSTORE:
@@ -203,165 +266,129 @@ struct Simulation {
         case Instruction::DSTORE:
         case Instruction::ASTORE:
             index = parse<uint8_t>(convert<1>(instruction.arguments));
-            std::cout << "var" << index << " = " << stack[stack.size() - 1] << std::endl;
-            stack.pop_back();
+            store(index);
             break;
         case Instruction::ISTORE_0:
         case Instruction::LSTORE_0:
         case Instruction::FSTORE_0:
         case Instruction::DSTORE_0:
         case Instruction::ASTORE_0:
-            std::cout << "var0 = " << stack[stack.size() - 1] << std::endl;
-            stack.pop_back();
+            store(0);
             break;
         case Instruction::ISTORE_1:
         case Instruction::LSTORE_1:
         case Instruction::FSTORE_1:
         case Instruction::DSTORE_1:
         case Instruction::ASTORE_1:
-            std::cout << "var1 = " << stack[stack.size() - 1] << std::endl;
-            stack.pop_back();
+            store(1);
             break;
         case Instruction::ISTORE_2:
         case Instruction::LSTORE_2:
         case Instruction::FSTORE_2:
         case Instruction::DSTORE_2:
         case Instruction::ASTORE_2:
-            std::cout << "var2 = " << stack[stack.size() - 1] << std::endl;
-            stack.pop_back();
+            store(2);
             break;
         case Instruction::ISTORE_3:
         case Instruction::LSTORE_3:
         case Instruction::FSTORE_3:
         case Instruction::DSTORE_3:
         case Instruction::ASTORE_3:
-            std::cout << "var3 = " << stack[stack.size() - 1] << std::endl;
-            stack.pop_back();
+            store(3);
             break;
         //TODO: Add array store instructions here
         case Instruction::POP:
-            stack.pop_back();
+            stack.pop1();
             break;
         case Instruction::POP2:
-            stack.resize(stack.size() - 2);
+            stack.pop2();
             break;
         case Instruction::DUP:
-            stack.push_back(stack[stack.size() - 1]);
+            stack.dup();
             break;
         case Instruction::DUP_X1:
-            stack.insert(stack.begin() + (stack.size() - 2), stack[stack.size() - 1]);
+            stack.dup_x1();
             break;
         case Instruction::DUP_X2:
-            stack.insert(stack.begin() + (stack.size() - 3), stack[stack.size() - 1]);
+            stack.dup_x2();
             break;
         case Instruction::DUP2:
-            // Insert top two values at the top of the stack
-            stack.push_back(stack[stack.size() - 2]);
-            stack.push_back(stack[stack.size() - 2]);
+            stack.dup2();
             break;
         case Instruction::DUP2_X1:
-            // Insert top two values below the third element
-            previous = stack.size();
-            stack.insert(stack.begin() + (previous - 3), stack[stack.size() - 2]);
-            stack.insert(stack.begin() + (previous - 3), stack[stack.size() - 1]);
+            stack.dup2_x1();
             break;
         case Instruction::DUP2_X2:
-            // Insert top two values below the fourth element
-            previous = stack.size();
-            stack.insert(stack.begin() + (previous - 4), stack[stack.size() - 2]);
-            stack.insert(stack.begin() + (previous - 4), stack[stack.size() - 1]);
+            stack.dup2_x2();
             break;
         case Instruction::SWAP:
-            tmp = stack[stack.size() - 1];
-            stack[stack.size() - 1] = stack[stack.size() - 2];
-            stack[stack.size() - 2] = tmp;
+            stack.swap();
             break;
         case Instruction::IADD:
         case Instruction::LADD:
         case Instruction::FADD:
         case Instruction::DADD:
-            expr = "(" + stack[stack.size() - 2] + " + " + stack[stack.size() - 1] + ")";
-            stack.resize(stack.size() - 2);
-            stack.push_back(expr);
+            binary_operation("+", value_kind(instruction.operation));
             break;
         case Instruction::ISUB:
         case Instruction::LSUB:
         case Instruction::FSUB:
         case Instruction::DSUB:
-            expr = "(" + stack[stack.size() - 2] + " - " + stack[stack.size() - 1] + ")";
-            stack.resize(stack.size() - 2);
-            stack.push_back(expr);
+            binary_operation("-", value_kind(instruction.operation));
             break;
         case Instruction::IMUL:
         case Instruction::LMUL:
         case Instruction::FMUL:
         case Instruction::DMUL:
-            expr = "(" + stack[stack.size() - 2] + " * " + stack[stack.size() - 1] + ")";
-            stack.resize(stack.size() - 2);
-            stack.push_back(expr);
+            binary_operation("*", value_kind(instruction.operation));
             break;
         case Instruction::IDIV:
         case Instruction::LDIV:
         case Instruction::FDIV:
         case Instruction::DDIV:
-            expr = "(" + stack[stack.size() - 2] + " / " + stack[stack.size() - 1] + ")";
-            stack.resize(stack.size() - 2);
-            stack.push_back(expr);
+            binary_operation("/", value_kind(instruction.operation));
             break;
         case Instruction::IREM:
         case Instruction::LREM:
         case Instruction::FREM:
         case Instruction::DREM:
-            expr = "(" + stack[stack.size() - 2] + " % " + stack[stack.size() - 1] + ")";
-            stack.resize(stack.size() - 2);
-            stack.push_back(expr);
+            binary_operation("%", value_kind(instruction.operation));
             break;
         case Instruction::INEG:
         case Instruction::LNEG:
         case Instruction::FNEG:
         case Instruction::DNEG:
-            stack[stack.size() - 1] = "(-" + stack[stack.size() - 1] + ")";
+            stack.peek() = expressions.unary("-", stack.peek(), value_kind(instruction.operation));
             break;
         case Instruction::ISHL:
         case Instruction::LSHL:
-            expr = "(" + stack[stack.size() - 2] + " << " + stack[stack.size() - 1] + ")";
-            stack.resize(stack.size() - 2);
-            stack.push_back(expr);
+            binary_operation("<<", value_kind(instruction.operation));
             break;
         case Instruction::ISHR:
         case Instruction::LSHR:
-            expr = "(" + stack[stack.size() - 2] + " >> " + stack[stack.size() - 1] + ")";
-            stack.resize(stack.size() - 2);
-            stack.push_back(expr);
+            binary_operation(">>", value_kind(instruction.operation));
             break;
         case Instruction::IUSHR:
         case Instruction::LUSHR:
-            expr = "(" + stack[stack.size() - 2] + " >>> " + stack[stack.size() - 1] + ")";
-            stack.resize(stack.size() - 2);
-            stack.push_back(expr);
+            binary_operation(">>>", value_kind(instruction.operation));
             break;
         case Instruction::IAND:
         case Instruction::LAND:
-            expr = "(" + stack[stack.size() - 2] + " & " + stack[stack.size() - 1] + ")";
-            stack.resize(stack.size() - 2);
-            stack.push_back(expr);
+            binary_operation("&", value_kind(instruction.operation));
             break;
         case Instruction::IOR:
         case Instruction::LOR:
-            expr = "(" + stack[stack.size() - 2] + " | " + stack[stack.size() - 1] + ")";
-            stack.resize(stack.size() - 2);
-            stack.push_back(expr);
+            binary_operation("|", value_kind(instruction.operation));
             break;
         case Instruction::IXOR:
         case Instruction::LXOR:
-            expr = "(" + stack[stack.size() - 2] + " ^ " + stack[stack.size() - 1] + ")";
-            stack.resize(stack.size() - 2);
-            stack.push_back(expr);
+            binary_operation("^", value_kind(instruction.operation));
             break;
         case Instruction::IINC:
             index = parse<uint8_t>(convert<1>(instruction.arguments));
             signed_value = parse<int8_t>(convert<1>(instruction.arguments, 1));
             std::cout << "var" << index << " += " << signed_value << std::endl;
+            expressions.store_local(index);
             break;
         //TODO: Insert conversion instructions here
         //TODO: Insert comparison instructions here
@@ -377,16 +404,27 @@ struct Simulation {
         //TODO: Insert other instructions here
         case Instruction::IRETURN:
         case Instruction::LRETURN:
+        case Instruction::FRETURN:
         case Instruction::DRETURN:
         case Instruction::ARETURN:
-            std::cout << "return " << stack[stack.size() - 1] << ";" << std::endl;
-            stack.pop_back();
+            std::cout << "return " << stack.pop()->to_string() << ";" << std::endl;
             break;
         case Instruction::RETURN:
             std::cout << "return;" << std::endl;
             break;
+        case Instruction::GETSTATIC:
+            load_field(parse<uint16_t>(convert<2>(instruction.arguments)), true);
+            break;
+        case Instruction::GETFIELD:
+            load_field(parse<uint16_t>(convert<2>(instruction.arguments)), false);
+            break;
+        case Instruction::ARRAYLENGTH:
+            stack.push(expressions.array_length(stack.pop_category_1()), StackSlot::INTEGER);
+            break;
         default:
             std::cout << "Simulation not yet implemented for opcode " << Instruction::name[instruction.operation] << std::endl;
+            // Might have written any field or array element
+            expressions.store_memory();
             break;
         }
     }
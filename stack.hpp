@@ -0,0 +1,259 @@
+#ifndef JJDE_STACK_HPP
+#define JJDE_STACK_HPP
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace jjde {
+
+/* Operand stack slots */
+
+struct StackSlot {
+    enum Kind : uint8_t {
+        INTEGER,        // int, short, char, byte, boolean
+        FLOAT,
+        REFERENCE,
+        RETURN_ADDRESS, // JSR/JSR_W
+        LONG,
+        DOUBLE,
+        TOP             // Upper half of a LONG or DOUBLE
+    };
+
+    // Values of category 2 (long and double) occupy two slots on the operand stack.
+    static bool is_category_2(Kind kind) {
+        return kind == LONG || kind == DOUBLE;
+    }
+};
+
+/* Fixed-capacity operand stack
+ *
+ * The stack is sized from the max_stack attribute of the method's Code attribute, which the JVM
+ * guarantees is never exceeded. Category 2 values are stored like the JVM does it: the value sits in
+ * the lower slot, and the slot above it is tagged TOP (with an empty value). This way, the DUP* and
+ * SWAP instructions can be implemented as they are specified (on slots, not on values), and each of
+ * them moves at most six slots.
+ *
+ * The buffers are only ever grown, so a single stack can be reused for all methods of a class.
+ */
+
+template <typename Value>
+class OperandStack {
+public:
+    OperandStack() = default;
+    explicit OperandStack(std::size_t capacity) { reset(capacity); }
+
+    // Empty the stack and make sure it can hold `capacity` slots (does not shrink the buffers)
+    void reset(std::size_t capacity) {
+        if (capacity > values.size()) {
+            values.resize(capacity);
+            kinds.resize(capacity);
+        }
+        limit = capacity;
+        top = 0;
+    }
+
+    std::size_t size() const { return top; }
+    std::size_t capacity() const { return limit; }
+    bool empty() const { return top == 0; }
+
+    // Push a value, which occupies two slots if it is of category 2
+    void push(Value value, StackSlot::Kind kind) {
+        if (kind == StackSlot::TOP) {
+            throw std::logic_error("Cannot push the upper half of a category 2 value on its own");
+        }
+        if (StackSlot::is_category_2(kind)) {
+            require_space(2);
+            values[top] = std::move(value);
+            kinds[top] = kind;
+            values[top + 1] = Value();
+            kinds[top + 1] = StackSlot::TOP;
+            top += 2;
+        } else {
+            require_space(1);
+            values[top] = std::move(value);
+            kinds[top] = kind;
+            ++top;
+        }
+    }
+
+    // Pop a single value (one or two slots, depending on its category)
+    Value pop() {
+        require_slots(1);
+        if (kinds[top - 1] == StackSlot::TOP) {
+            require_slots(2);
+            top -= 2;
+        } else {
+            top -= 1;
+        }
+        return std::move(values[top]);
+    }
+
+    // Pop a value that must be of category 1
+    Value pop_category_1() {
+        require_category_1(0);
+        return pop();
+    }
+
+    // Access the value `depth` values (not slots) below the top of the stack
+    Value const& peek(std::size_t depth = 0) const {
+        std::size_t slot = top;
+        for (std::size_t value = 0; value <= depth; ++value) {
+            require_slots(top - slot + 1);
+            slot -= (kinds[slot - 1] == StackSlot::TOP) ? 2 : 1;
+        }
+        return values[slot];
+    }
+
+    Value & peek(std::size_t depth = 0) {
+        return const_cast<Value &>(static_cast<OperandStack const&>(*this).peek(depth));
+    }
+
+    StackSlot::Kind peek_kind(std::size_t depth = 0) const {
+        std::size_t slot = top;
+        for (std::size_t value = 0; value <= depth; ++value) {
+            require_slots(top - slot + 1);
+            slot -= (kinds[slot - 1] == StackSlot::TOP) ? 2 : 1;
+        }
+        return kinds[slot];
+    }
+
+    /* Stack manipulation instructions (JVMS §6.5). These operate on slots. */
+
+    // ..., v1 -> ...
+    void pop1() {
+        require_category_1(0);
+        --top;
+    }
+
+    // ..., v2, v1 -> ...
+    void pop2() {
+        require_slots(2);
+        require_unsplit(2);
+        top -= 2;
+    }
+
+    // ..., v1 -> ..., v1, v1
+    void dup() {
+        require_category_1(0);
+        require_space(1);
+        copy_slot(top - 1, top);
+        top += 1;
+    }
+
+    // ..., v2, v1 -> ..., v1, v2, v1
+    void dup_x1() {
+        require_category_1(0);
+        require_category_1(1);
+        require_space(1);
+        move_slots(top - 2, top - 1, 2);
+        copy_slot(top, top - 2);
+        top += 1;
+    }
+
+    // ..., v3, v2, v1 -> ..., v1, v3, v2, v1
+    void dup_x2() {
+        require_category_1(0);
+        require_slots(3);
+        require_unsplit(3);
+        require_space(1);
+        move_slots(top - 3, top - 2, 3);
+        copy_slot(top, top - 3);
+        top += 1;
+    }
+
+    // ..., v2, v1 -> ..., v2, v1, v2, v1
+    void dup2() {
+        require_slots(2);
+        require_unsplit(2);
+        require_space(2);
+        copy_slot(top - 2, top);
+        copy_slot(top - 1, top + 1);
+        top += 2;
+    }
+
+    // ..., v3, v2, v1 -> ..., v2, v1, v3, v2, v1
+    void dup2_x1() {
+        require_slots(3);
+        require_unsplit(2);
+        require_unsplit(3);
+        require_space(2);
+        move_slots(top - 3, top - 1, 3);
+        copy_slot(top, top - 3);
+        copy_slot(top + 1, top - 2);
+        top += 2;
+    }
+
+    // ..., v4, v3, v2, v1 -> ..., v2, v1, v4, v3, v2, v1
+    void dup2_x2() {
+        require_slots(4);
+        require_unsplit(2);
+        require_unsplit(4);
+        require_space(2);
+        move_slots(top - 4, top - 2, 4);
+        copy_slot(top, top - 4);
+        copy_slot(top + 1, top - 3);
+        top += 2;
+    }
+
+    // ..., v2, v1 -> ..., v1, v2
+    void swap() {
+        require_category_1(0);
+        require_category_1(1);
+        std::swap(values[top - 1], values[top - 2]);
+        std::swap(kinds[top - 1], kinds[top - 2]);
+    }
+
+private:
+    std::vector<Value> values;
+    std::vector<StackSlot::Kind> kinds;
+    std::size_t limit = 0;
+    std::size_t top = 0;
+
+    void require_slots(std::size_t count) const {
+        if (top < count) {
+            throw std::logic_error("Operand stack underflow (" + std::to_string(count) + " slots required, " + std::to_string(top) + " available)");
+        }
+    }
+
+    void require_space(std::size_t count) const {
+        if (top + count > limit) {
+            throw std::logic_error("Operand stack overflow (maximum stack size is " + std::to_string(limit) + ")");
+        }
+    }
+
+    // The value `depth` slots below the top must be a complete category 1 value
+    void require_category_1(std::size_t depth) const {
+        require_slots(depth + 1);
+        StackSlot::Kind kind = kinds[top - depth - 1];
+        if (kind == StackSlot::TOP || StackSlot::is_category_2(kind)) {
+            throw std::logic_error("Category 1 stack operation applied to a category 2 value");
+        }
+    }
+
+    // The boundary below the topmost `count` slots must not split a category 2 value
+    void require_unsplit(std::size_t count) const {
+        if (top > count && kinds[top - count] == StackSlot::TOP) {
+            throw std::logic_error("Stack operation splits a category 2 value");
+        }
+    }
+
+    void copy_slot(std::size_t from, std::size_t to) {
+        values[to] = values[from];
+        kinds[to] = kinds[from];
+    }
+
+    // Move `count` slots starting at `from` to start at `to` (with to > from)
+    void move_slots(std::size_t from, std::size_t to, std::size_t count) {
+        for (std::size_t offset = count; offset > 0; --offset) {
+            values[to + offset - 1] = std::move(values[from + offset - 1]);
+            kinds[to + offset - 1] = kinds[from + offset - 1];
+        }
+    }
+};
+
+}
+
+#endif // JJDE_STACK_HPP
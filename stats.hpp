@@ -0,0 +1,222 @@
+#ifndef JJDE_STATS_HPP
+#define JJDE_STATS_HPP
+
+#include <ostream>
+
+#ifdef JJDE_ENABLE_STATS
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <mutex>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+#endif
+
+namespace jjde {
+
+/* Statistics
+ *
+ * Time spent in each phase, counters of the decoded data and the slowest methods of a run, shared by
+ * all threads (see --stats). Only built with JJDE_ENABLE_STATS (CONFIG += stats); otherwise all of the
+ * JJDE_STATS_* macros expand to nothing, and their arguments are not evaluated.
+ *
+ * Phase times are inclusive: reading a class includes reading its constants. With
+ * JJDE_COUNT_ALLOCATIONS (CONFIG += stats_allocations), the global operator new and delete are
+ * replaced to count all allocations of the program. Since everything is compiled as a single translation unit, defining
+ * it in this header is fine.
+ */
+
+namespace stats {
+
+// The simulation has no phase, since nothing runs it (see passes.hpp)
+enum Phase { READ_CLASS, CONSTANTS, DISASSEMBLY, ANNOTATION, CODE_FLOW, PHASE_COUNT };
+enum Counter { BYTES_READ, CONSTANTS_DECODED, INSTRUCTIONS_DECODED, BLOCKS_BUILT, COUNTER_COUNT };
+
+#ifdef JJDE_ENABLE_STATS
+
+char const* const phase_names[PHASE_COUNT] = {"read class", "constants", "disassembly", "annotation", "code flow"};
+char const* const counter_names[COUNTER_COUNT] = {"bytes read", "constants decoded", "instructions decoded", "blocks built"};
+
+constexpr std::size_t slowest_method_count = 10;
+
+struct Totals {
+    std::atomic<uint64_t> phase_nanoseconds[PHASE_COUNT] = {};
+    std::atomic<uint64_t> phase_calls[PHASE_COUNT] = {};
+    std::atomic<uint64_t> counters[COUNTER_COUNT] = {};
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> allocated_bytes{0};
+
+    // Slowest methods so far (nanoseconds and name), a min-heap of at most slowest_method_count entries
+    std::vector<std::pair<uint64_t, std::string>> slowest;
+    std::mutex slowest_mutex;
+};
+
+inline Totals & totals() {
+    static Totals instance;
+    return instance;
+}
+
+inline void count(Counter counter, uint64_t amount) {
+    totals().counters[counter].fetch_add(amount, std::memory_order_relaxed);
+}
+
+inline uint64_t elapsed(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+class PhaseTimer {
+public:
+    explicit PhaseTimer(Phase phase_) : phase(phase_), start(std::chrono::steady_clock::now()) {}
+
+    ~PhaseTimer() {
+        totals().phase_nanoseconds[phase].fetch_add(elapsed(start), std::memory_order_relaxed);
+        totals().phase_calls[phase].fetch_add(1, std::memory_order_relaxed);
+    }
+
+private:
+    Phase phase;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Ranks the method by the time until the timer is destroyed; the name is only built if it ranks
+template <typename Name>
+class MethodTimer {
+public:
+    explicit MethodTimer(Name name_) : name(std::move(name_)), start(std::chrono::steady_clock::now()) {}
+
+    ~MethodTimer() {
+        uint64_t nanoseconds = elapsed(start);
+        auto greater = [](std::pair<uint64_t, std::string> const& a, std::pair<uint64_t, std::string> const& b) { return a.first > b.first; };
+        std::lock_guard<std::mutex> lock(totals().slowest_mutex);
+        std::vector<std::pair<uint64_t, std::string>> & slowest = totals().slowest;
+        if (slowest.size() == slowest_method_count) {
+            if (slowest.front().first >= nanoseconds) return;
+            std::pop_heap(slowest.begin(), slowest.end(), greater);
+            slowest.pop_back();
+        }
+        slowest.emplace_back(nanoseconds, name());
+        std::push_heap(slowest.begin(), slowest.end(), greater);
+    }
+
+private:
+    Name name;
+    std::chrono::steady_clock::time_point start;
+};
+
+template <typename Name>
+MethodTimer<Name> time_method(Name name) {
+    return MethodTimer<Name>(std::move(name));
+}
+
+inline void report(std::ostream & output) {
+    Totals & data = totals();
+    output << "Statistics:" << std::endl << std::fixed << std::setprecision(3);
+    for (std::size_t phase = 0; phase < PHASE_COUNT; ++phase) {
+        output << "    " << std::left << std::setw(22) << phase_names[phase] << std::right
+               << std::setw(12) << data.phase_nanoseconds[phase] / 1e6 << " ms in " << data.phase_calls[phase] << " calls" << std::endl;
+    }
+    for (std::size_t counter = 0; counter < COUNTER_COUNT; ++counter) {
+        output << "    " << std::left << std::setw(22) << counter_names[counter] << std::right << std::setw(12) << data.counters[counter] << std::endl;
+    }
+#ifdef JJDE_COUNT_ALLOCATIONS
+    output << "    " << std::left << std::setw(22) << "allocations" << std::right << std::setw(12) << data.allocations
+           << " (" << data.allocated_bytes << " bytes)" << std::endl;
+#endif
+    std::vector<std::pair<uint64_t, std::string>> slowest;
+    {
+        std::lock_guard<std::mutex> lock(data.slowest_mutex);
+        slowest = data.slowest;
+    }
+    std::sort(slowest.begin(), slowest.end(), [](auto const& a, auto const& b) { return a.first > b.first; });
+    output << "Slowest methods:" << std::endl;
+    for (auto const& method : slowest) {
+        output << "    " << std::setw(12) << method.first / 1e6 << " ms  " << method.second << std::endl;
+    }
+    output << std::defaultfloat;
+}
+
+#define JJDE_STATS_CONCAT_(a, b) a##b
+#define JJDE_STATS_CONCAT(a, b) JJDE_STATS_CONCAT_(a, b)
+#define JJDE_STATS_TIME(phase) ::jjde::stats::PhaseTimer JJDE_STATS_CONCAT(jjde_phase_timer_, __LINE__)(::jjde::stats::phase)
+#define JJDE_STATS_COUNT(counter, amount) ::jjde::stats::count(::jjde::stats::counter, (amount))
+// name is an expression for the name of the method, only evaluated if the method is among the slowest
+#define JJDE_STATS_TIME_METHOD(name) auto JJDE_STATS_CONCAT(jjde_method_timer_, __LINE__) = ::jjde::stats::time_method([&]() -> std::string { return (name); })
+
+#else
+
+inline void report(std::ostream & output) {
+    output << "Statistics are not available (build with CONFIG += stats)" << std::endl;
+}
+
+#define JJDE_STATS_TIME(phase)
+#define JJDE_STATS_COUNT(counter, amount)
+#define JJDE_STATS_TIME_METHOD(name)
+
+#endif
+
+}
+
+}
+
+#if defined(JJDE_ENABLE_STATS) && defined(JJDE_COUNT_ALLOCATIONS)
+
+/* Counted allocations
+ *
+ * All replaceable forms of operator new and delete, so that every allocation is counted and freed by
+ * the matching function. Allocation and release are kept out of line: if the compiler inlined free()
+ * into code that called operator new, it would report a mismatched deallocation.
+ */
+
+namespace jjde::stats::detail {
+
+[[gnu::noinline]] inline void * allocate(std::size_t size, std::size_t alignment) noexcept {
+    Totals & data = totals();
+    data.allocations.fetch_add(1, std::memory_order_relaxed);
+    data.allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (size == 0) size = 1;
+    if (alignment <= alignof(std::max_align_t)) return std::malloc(size);
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+[[gnu::noinline]] inline void release(void * pointer) noexcept {
+    std::free(pointer);
+}
+
+inline void * allocate_or_throw(std::size_t size, std::size_t alignment) {
+    if (void * pointer = allocate(size, alignment)) return pointer;
+    throw std::bad_alloc();
+}
+
+}
+
+void * operator new(std::size_t size) { return jjde::stats::detail::allocate_or_throw(size, 0); }
+void * operator new[](std::size_t size) { return jjde::stats::detail::allocate_or_throw(size, 0); }
+void * operator new(std::size_t size, std::nothrow_t const&) noexcept { return jjde::stats::detail::allocate(size, 0); }
+void * operator new[](std::size_t size, std::nothrow_t const&) noexcept { return jjde::stats::detail::allocate(size, 0); }
+void * operator new(std::size_t size, std::align_val_t alignment) { return jjde::stats::detail::allocate_or_throw(size, (std::size_t) alignment); }
+void * operator new[](std::size_t size, std::align_val_t alignment) { return jjde::stats::detail::allocate_or_throw(size, (std::size_t) alignment); }
+void * operator new(std::size_t size, std::align_val_t alignment, std::nothrow_t const&) noexcept { return jjde::stats::detail::allocate(size, (std::size_t) alignment); }
+void * operator new[](std::size_t size, std::align_val_t alignment, std::nothrow_t const&) noexcept { return jjde::stats::detail::allocate(size, (std::size_t) alignment); }
+
+void operator delete(void * pointer) noexcept { jjde::stats::detail::release(pointer); }
+void operator delete[](void * pointer) noexcept { jjde::stats::detail::release(pointer); }
+void operator delete(void * pointer, std::size_t) noexcept { jjde::stats::detail::release(pointer); }
+void operator delete[](void * pointer, std::size_t) noexcept { jjde::stats::detail::release(pointer); }
+void operator delete(void * pointer, std::nothrow_t const&) noexcept { jjde::stats::detail::release(pointer); }
+void operator delete[](void * pointer, std::nothrow_t const&) noexcept { jjde::stats::detail::release(pointer); }
+void operator delete(void * pointer, std::align_val_t) noexcept { jjde::stats::detail::release(pointer); }
+void operator delete[](void * pointer, std::align_val_t) noexcept { jjde::stats::detail::release(pointer); }
+void operator delete(void * pointer, std::size_t, std::align_val_t) noexcept { jjde::stats::detail::release(pointer); }
+void operator delete[](void * pointer, std::size_t, std::align_val_t) noexcept { jjde::stats::detail::release(pointer); }
+void operator delete(void * pointer, std::align_val_t, std::nothrow_t const&) noexcept { jjde::stats::detail::release(pointer); }
+void operator delete[](void * pointer, std::align_val_t, std::nothrow_t const&) noexcept { jjde::stats::detail::release(pointer); }
+
+#endif
+
+#endif // JJDE_STATS_HPP
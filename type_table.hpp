@@ -0,0 +1,270 @@
+#ifndef JJDE_TYPE_TABLE_HPP
+#define JJDE_TYPE_TABLE_HPP
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "signatures.hpp"
+#include "types.hpp"
+
+namespace jjde {
+
+/* Interned types
+ *
+ * Every distinct type exists exactly once per process in the global TypeTable, and is referred to by a
+ * TypeHandle (a single pointer). Interned types are immutable, and their children are handles as
+ * well, so java.lang.String is shared by every type that mentions it. Handles compare in O(1), and the
+ * rendered form of each type is computed once, when it is interned.
+ */
+
+struct InternedType;
+
+class TypeHandle {
+public:
+    TypeHandle() = default;
+
+    InternedType const* operator->() const { return pointer; }
+    InternedType const& operator*() const { return *pointer; }
+    explicit operator bool() const { return pointer != nullptr; }
+
+    bool operator==(TypeHandle const& other) const { return pointer == other.pointer; }
+    bool operator!=(TypeHandle const& other) const { return pointer != other.pointer; }
+
+    // Cached rendering (equivalent to Type::to_string())
+    std::string const& to_string() const;
+
+private:
+    InternedType const* pointer = nullptr;
+
+    explicit TypeHandle(InternedType const* pointer_) : pointer(pointer_) {}
+    friend class TypeTable;
+    friend struct std::hash<TypeHandle>;
+};
+
+}
+
+namespace std {
+
+template <>
+struct hash<jjde::TypeHandle> {
+    std::size_t operator()(jjde::TypeHandle const& handle) const {
+        return std::hash<jjde::InternedType const*>()(handle.pointer);
+    }
+};
+
+}
+
+namespace jjde {
+
+struct InternedType {
+    Type::Usage usage;
+
+    // For normal and function types
+    std::vector<TypeHandle> generics;
+
+    // For leaf types (always normal types)
+    std::string java_type;
+    std::size_t array_dimensions = 0;
+
+    // For function types
+    TypeHandle return_type;
+    std::vector<TypeHandle> argument_types;
+
+    // to_string() without a name (filled in by the TypeTable)
+    std::string rendered;
+    std::size_t hash = 0;
+
+    // Same output as Type::to_string
+    std::string to_string(std::string const& name="", std::vector<std::string> const& argument_names=std::vector<std::string>()) const {
+        if (name == "" && argument_names.empty() && !rendered.empty()) return rendered;
+
+        std::string generic_list;
+        for (std::size_t generic = 0; generic < generics.size(); ++generic) {
+            generic_list += (generic == 0 ? "<" : ", ") + generics[generic].to_string();
+        }
+        if (generic_list != "") generic_list += ">";
+
+        std::string output;
+        if (usage == Type::Usage::FUNCTION) {
+            // Type parameters precede the return type
+            if (generic_list != "") output = generic_list + " ";
+            output += return_type.to_string() + (name == "" ? "" : " " + name) + "(";
+            for (std::size_t argument = 0; argument < argument_types.size(); ++argument) {
+                if (argument != 0) output += ", ";
+                output += argument_types[argument].to_string();
+                if (argument_names.size() > argument && argument_names[argument] != "") {
+                    output += " " + argument_names[argument];
+                }
+            }
+            output += ")";
+        } else {
+            output = java_type + generic_list;
+            for (std::size_t dimension = 0; dimension < array_dimensions; ++dimension) {
+                output += "[]";
+            }
+            if (name != "") output += " " + name;
+        }
+        return output;
+    }
+};
+
+inline std::string const& TypeHandle::to_string() const {
+    return pointer->rendered;
+}
+
+namespace detail {
+
+struct InternedTypeHash {
+    std::size_t operator()(InternedType const* type) const {
+        return type->hash;
+    }
+};
+
+struct InternedTypeEqual {
+    bool operator()(InternedType const* a, InternedType const* b) const {
+        // Children are interned, so comparing handles is a structural comparison.
+        return a->usage == b->usage
+            && a->array_dimensions == b->array_dimensions
+            && a->return_type == b->return_type
+            && a->java_type == b->java_type
+            && a->generics == b->generics
+            && a->argument_types == b->argument_types;
+    }
+};
+
+}
+
+/* Process-wide type table (thread-safe) */
+
+class TypeTable {
+public:
+    static TypeTable & global() {
+        static TypeTable table;
+        return table;
+    }
+
+    // Decode and intern a descriptor or signature. Each distinct signature string is only decoded once.
+    TypeHandle intern(std::string_view signature) {
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            auto it = signatures.find(signature);
+            if (it != signatures.end()) return it->second;
+        }
+        // The nodes are only needed until the type is interned, so the arena of each thread is reused
+        thread_local SignatureArena arena;
+        arena.clear();
+        SignatureNode const* node = parse_types(signature, arena);
+        if (!node) throw std::logic_error("Empty type signature");
+        TypeHandle handle = intern(node); // Only the first of several standard types (like decode_type)
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (signatures.find(signature) == signatures.end()) {
+            signature_texts.emplace_back(signature);
+            signatures.emplace(signature_texts.back(), handle);
+        }
+        return handle;
+    }
+
+    // Intern a parsed type (same rendering as detail::to_type, without building a Type first)
+    TypeHandle intern(SignatureNode const* node) {
+        InternedType candidate;
+        candidate.usage = Type::Usage::STANDARD;
+        // Arrays are their component type with more dimensions
+        for (; node->kind == SignatureNode::ARRAY; node = node->element) ++candidate.array_dimensions;
+        switch (node->kind) {
+        case SignatureNode::BASE:
+            candidate.java_type = detail::java_base_type(node->indicator);
+            break;
+        case SignatureNode::CLASS:
+            // Inner classes of generic classes are qualified with the (parameterized) outer class
+            candidate.java_type = node->element ? intern(node->element).to_string() + "." + detail::java_class_name(node->name) : detail::java_class_name(node->name);
+            for (SignatureNode const* argument = node->arguments; argument; argument = argument->next) {
+                candidate.generics.push_back(intern(argument));
+            }
+            break;
+        case SignatureNode::TYPE_VARIABLE:
+            candidate.java_type = std::string(node->name);
+            break;
+        case SignatureNode::WILDCARD:
+            if (node->indicator == '*') candidate.java_type = "?";
+            else candidate.java_type = std::string(node->indicator == '+' ? "? extends " : "? super ") + intern(node->element).to_string();
+            break;
+        case SignatureNode::TYPE_PARAMETER:
+            // T extends A & B (an implicit java.lang.Object bound is omitted)
+            candidate.java_type = std::string(node->name);
+            for (SignatureNode const* bound = node->arguments; bound; bound = bound->next) {
+                if (bound == node->arguments && !bound->next && bound->kind == SignatureNode::CLASS && !bound->arguments && bound->name == "java/lang/Object") break;
+                candidate.java_type += (bound == node->arguments ? " extends " : " & ") + intern(bound).to_string();
+            }
+            break;
+        case SignatureNode::METHOD:
+            candidate.usage = Type::Usage::FUNCTION;
+            for (SignatureNode const* parameter = node->parameters; parameter; parameter = parameter->next) {
+                candidate.generics.push_back(intern(parameter));
+            }
+            candidate.return_type = intern(node->element);
+            for (SignatureNode const* argument = node->arguments; argument; argument = argument->next) {
+                candidate.argument_types.push_back(intern(argument));
+            }
+            break;
+        case SignatureNode::ARRAY:
+        case SignatureNode::CLASS_SIGNATURE:
+        default:
+            throw std::logic_error("Cannot convert signature to a type: " + std::string(node->text));
+        }
+        return insert(std::move(candidate));
+    }
+
+    std::size_t size() const {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return types.size();
+    }
+
+private:
+    TypeTable() = default;
+
+    mutable std::shared_mutex mutex;
+    std::deque<InternedType> types; // Stable addresses, never freed
+    std::unordered_set<InternedType const*, detail::InternedTypeHash, detail::InternedTypeEqual> table;
+    // Keys point into signature_texts, so lookups need not copy the signature
+    std::deque<std::string> signature_texts; // Stable addresses, never freed
+    std::unordered_map<std::string_view, TypeHandle> signatures;
+
+    TypeHandle insert(InternedType && candidate) {
+        std::size_t hash = std::hash<std::string>()(candidate.java_type);
+        hash = hash * 31 + candidate.usage;
+        hash = hash * 31 + candidate.array_dimensions;
+        hash = hash * 31 + std::hash<TypeHandle>()(candidate.return_type);
+        for (TypeHandle const& generic : candidate.generics) hash = hash * 31 + std::hash<TypeHandle>()(generic);
+        for (TypeHandle const& argument : candidate.argument_types) hash = hash * 31 + std::hash<TypeHandle>()(argument);
+        candidate.hash = hash;
+
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            auto it = table.find(&candidate);
+            if (it != table.end()) return TypeHandle(*it);
+        }
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        auto it = table.find(&candidate);
+        if (it != table.end()) return TypeHandle(*it);
+        candidate.rendered = candidate.to_string();
+        types.push_back(std::move(candidate));
+        table.insert(&types.back());
+        return TypeHandle(&types.back());
+    }
+};
+
+inline TypeHandle intern_type(std::string_view signature) {
+    return TypeTable::global().intern(signature);
+}
+
+}
+
+#endif // JJDE_TYPE_TABLE_HPP
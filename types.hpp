@@ -3,8 +3,12 @@
 
 #include <algorithm>
 #include <memory>
+#include <string>
+#include <string_view>
 #include <vector>
 
+#include "signatures.hpp"
+
 namespace jjde {
 
 /* Types */
@@ -96,7 +100,10 @@ struct Type {
             // Add >
             in_generics += ">";
         }
-        // Concatenate the parts
+        // Concatenate the parts (type parameters of functions precede the return type)
+        if (usage == Usage::FUNCTION && in_generics != "") {
+            return in_generics + " " + pre_generics + post_generics;
+        }
         return pre_generics + in_generics + post_generics;
     }
 };
@@ -116,145 +123,98 @@ struct Type {
  *     (Ljava/util/ArrayList;)[Ljava/lang/String;
  */
 
-inline Type decode_type(std::string const& internal_type);
-
-enum type_state {
-    FULL_TYPE,
-    CLASS_TYPE,
-    GENERIC_TYPE
-};
-
-std::vector<Type> decode_types(std::string const& internal_type) {
-    std::string::size_type open = internal_type.find('(');
-    std::string::size_type close = internal_type.find(')');
-
-    if (open == std::string::npos && close == std::string::npos) {
-        // Standard type
-        std::vector<Type> types;
-
-        // Temporaries for string walking
-        std::size_t array_count = 0;
-        std::size_t generic_count = 0;
-        std::string current_type;
-        std::string current_generics = "";
-        type_state state = FULL_TYPE;
-
-        // Iterate over the string
-        for (std::string::size_type index = 0; index < internal_type.size(); ++index) {
-            char c = internal_type[index];
-            if (c == '<') {
-                current_generics += c;
-                ++generic_count;
-            } else if (c == '>') {
-                current_generics += c;
-                --generic_count;
-            } else if (state == FULL_TYPE) {
-                switch (c) {
-                case '[':
-                    ++array_count;
-                    break;
-                case 'B':
-                    types.push_back(Type{current_type, Type::Usage::STANDARD, std::vector<Type>(), "byte", array_count});
-                    array_count = 0;
-                    current_type = "";
-                    break;
-                case 'C':
-                    types.push_back(Type{current_type, Type::Usage::STANDARD, std::vector<Type>(), "char", array_count});
-                    array_count = 0;
-                    current_type = "";
-                    break;
-                case 'D':
-                    types.push_back(Type{current_type, Type::Usage::STANDARD, std::vector<Type>(), "double", array_count});
-                    array_count = 0;
-                    current_type = "";
-                    break;
-                case 'F':
-                    types.push_back(Type{current_type, Type::Usage::STANDARD, std::vector<Type>(), "float", array_count});
-                    array_count = 0;
-                    current_type = "";
-                    break;
-                case 'I':
-                    types.push_back(Type{current_type, Type::Usage::STANDARD, std::vector<Type>(), "int", array_count});
-                    array_count = 0;
-                    current_type = "";
-                    break;
-                case 'J':
-                    types.push_back(Type{current_type, Type::Usage::STANDARD, std::vector<Type>(), "long", array_count});
-                    array_count = 0;
-                    current_type = "";
-                    break;
-                case 'S':
-                    types.push_back(Type{current_type, Type::Usage::STANDARD, std::vector<Type>(), "short", array_count});
-                    array_count = 0;
-                    current_type = "";
-                    break;
-                case 'V':
-                    types.push_back(Type{current_type, Type::Usage::STANDARD, std::vector<Type>(), "void", array_count});
-                    array_count = 0;
-                    current_type = "";
-                    break;
-                case 'Z':
-                    types.push_back(Type{current_type, Type::Usage::STANDARD, std::vector<Type>(), "boolean", array_count});
-                    array_count = 0;
-                    current_type = "";
-                    break;
-                case 'T':
-                case '*':
-                    state = GENERIC_TYPE;
-                    break;
-                case 'L':
-                    state = CLASS_TYPE;
-                    break;
-                default:
-                    throw std::logic_error("Invalid type specifier");
-                }
-            } else {
-                if (generic_count > 0) {
-                    current_generics += c;
-                } else if (c == ';') {
-                    // Parse generics
-                    std::vector<Type> generics;
-                    if (current_generics.size() > 0) {
-                        generics = decode_types(current_generics.substr(1, current_generics.size() - 2));
-                    }
-
-                    // Add type
-                    std::string proper_type = current_type;
-                    std::replace(proper_type.begin(), proper_type.end(), '/', '.');
-                    std::replace(proper_type.begin(), proper_type.end(), '$', '.');
+namespace detail {
+
+std::string java_base_type(char indicator) {
+    switch (indicator) {
+    case 'B': return "byte";
+    case 'C': return "char";
+    case 'D': return "double";
+    case 'F': return "float";
+    case 'I': return "int";
+    case 'J': return "long";
+    case 'S': return "short";
+    case 'V': return "void";
+    case 'Z': return "boolean";
+    default:  throw std::logic_error("Invalid type specifier");
+    }
+}
 
-                    std::string base;
-                    if (state == CLASS_TYPE) base = "L" + current_type + ";";
-                    else if (state == GENERIC_TYPE) base = "T" + current_type + ";";
-                    types.push_back(Type{base, Type::Usage::STANDARD, generics, proper_type, array_count});
+// Binary class names use '/' as package separator and '$' for nested classes
+std::string java_class_name(std::string_view binary_name) {
+    std::string name(binary_name);
+    for (char & c : name) {
+        if (c == '/' || c == '$') c = '.';
+    }
+    return name;
+}
 
-                    // Reset
-                    current_type = "";
-                    current_generics = "";
-                    generic_count = 0;
-                    array_count = 0;
-                    state = FULL_TYPE;
-                } else {
-                    current_type += c;
-                }
-            }
+std::vector<Type> to_types(SignatureNode const* first);
+
+Type to_type(SignatureNode const* node) {
+    std::string name;
+    switch (node->kind) {
+    case SignatureNode::BASE:
+        return Type{std::string(node->text), Type::Usage::STANDARD, std::vector<Type>(), java_base_type(node->indicator), 0};
+    case SignatureNode::ARRAY: {
+        Type element = to_type(node->element);
+        element.internal_type = std::string(node->text);
+        ++element.array_dimensions;
+        return element;
+    }
+    case SignatureNode::CLASS:
+        // Inner classes of generic classes are qualified with the (parameterized) outer class
+        name = node->element ? to_type(node->element).to_string() + "." + java_class_name(node->name) : java_class_name(node->name);
+        return Type{std::string(node->text), Type::Usage::STANDARD, to_types(node->arguments), name, 0};
+    case SignatureNode::TYPE_VARIABLE:
+        return Type{std::string(node->text), Type::Usage::STANDARD, std::vector<Type>(), std::string(node->name), 0};
+    case SignatureNode::WILDCARD:
+        if (node->indicator == '*') name = "?";
+        else name = std::string(node->indicator == '+' ? "? extends " : "? super ") + to_type(node->element).to_string();
+        return Type{std::string(node->text), Type::Usage::STANDARD, std::vector<Type>(), name, 0};
+    case SignatureNode::TYPE_PARAMETER:
+        // T extends A & B (an implicit java.lang.Object bound is omitted)
+        name = std::string(node->name);
+        for (SignatureNode const* bound = node->arguments; bound; bound = bound->next) {
+            if (bound == node->arguments && !bound->next && bound->kind == SignatureNode::CLASS && !bound->arguments && bound->name == "java/lang/Object") break;
+            name += (bound == node->arguments ? " extends " : " & ") + to_type(bound).to_string();
         }
+        return Type{std::string(node->text), Type::Usage::STANDARD, std::vector<Type>(), name, 0};
+    case SignatureNode::METHOD:
+        return Type{std::string(node->text), Type::Usage::FUNCTION, to_types(node->parameters), to_type(node->element), to_types(node->arguments)};
+    case SignatureNode::CLASS_SIGNATURE:
+    default:
+        throw std::logic_error("Cannot convert signature to a type: " + std::string(node->text));
+    }
+}
 
-        return types;
-    } else if (open == std::string::npos || close == std::string::npos) {
-        throw std::logic_error("Malformed type: " + internal_type);
-    } else {
-        // Function type
-        std::string generics = internal_type.substr(0, open);
-        std::string arguments = internal_type.substr(open + 1, close - open - 1);
-        std::string return_type = internal_type.substr(close + 1);
+std::vector<Type> to_types(SignatureNode const* first) {
+    std::vector<Type> types;
+    for (SignatureNode const* node = first; node; node = node->next) {
+        types.push_back(to_type(node));
+    }
+    return types;
+}
+
+}
 
-        // Recurse
-        return std::vector<Type>{Type{internal_type, Type::Usage::FUNCTION, decode_types(generics), decode_type(return_type), decode_types(arguments)}};
+// A method descriptor or signature, or a list of standard types (nullptr if empty). Method types are
+// recognized by their first character, '(' or '<' (type parameters).
+SignatureNode const* parse_types(std::string_view internal_type, SignatureArena & arena) {
+    SignatureParser parser(internal_type, arena);
+    if (!internal_type.empty() && (internal_type[0] == '(' || internal_type[0] == '<')) {
+        return parser.parse_method();
     }
+    return parser.parse_types();
+}
+
+// Deep copies of the types (the TypeTable interns straight from the signature nodes instead)
+std::vector<Type> decode_types(std::string_view internal_type) {
+    SignatureArena arena;
+    return detail::to_types(parse_types(internal_type, arena));
 }
 
-inline Type decode_type(std::string const& internal_type) {
+inline Type decode_type(std::string_view internal_type) {
     return decode_types(internal_type).at(0); // Use at to avoid segfaults.
 }
 
@@ -0,0 +1,7 @@
+#ifndef JJDE_VERSION_HPP
+#define JJDE_VERSION_HPP
+
+// Bump whenever the output format changes (invalidates cached results)
+#define JJDE_VERSION "0.3.3"
+
+#endif // JJDE_VERSION_HPP